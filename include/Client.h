@@ -6,6 +6,8 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 using namespace std;
 
 // Use forward declarations for modules, rather than including all headers
@@ -31,9 +33,12 @@ void PrintStackTrace();
 class Client
 {
    public:
-    Client();
+    // cfgOverrides are config lines like "video::headless=1", applied on top of config.ini
+    Client(const vector<string>& cfgOverrides = vector<string>());
     void Start();
 
+    vector<string> cfgOverrides;  // before the modules, since Config reads it
+
     // these must be pointers because we use forward declarations (since the sizes of the types are
     // unknown)
     shared_ptr<SegFaultHandler> segFaultHandler;  // created first to catch initialization errors
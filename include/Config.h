@@ -7,14 +7,43 @@
 #pragma once
 
 #include "Module.h"
+#include "ConfigSettings.h"
 #include <map>
 #include <vector>
 
+// the resolved value of every setting in ConfigSettings.h
+struct ConfigValues
+{
+#define CONFIG_VALUE_INT(member, section, name, def, isAllowed) i32 member;
+#define CONFIG_VALUE_BOOL(member, section, name, def) bool member;
+#define CONFIG_VALUE_STRING(member, section, name, def) string member;
+#define CONFIG_VALUE_INT_LIST(member, section, name) vector<i32> member;
+
+    CONFIG_SETTINGS(CONFIG_VALUE_INT, CONFIG_VALUE_BOOL, CONFIG_VALUE_STRING,
+                    CONFIG_VALUE_INT_LIST)
+
+#undef CONFIG_VALUE_INT
+#undef CONFIG_VALUE_BOOL
+#undef CONFIG_VALUE_STRING
+#undef CONFIG_VALUE_INT_LIST
+};
+
 class Config : public Module
 {
    public:
     Config(Client& c);
 
+    // every declared setting, resolved when the config was loaded (use this rather than the
+    // getters below, which parse the value on each call)
+    const ConfigValues& Values() { return values; }
+
+    // all settings in a section (lowercase names), nullptr if there's no such section
+    const map<string, string>* GetSection(const char* section);
+
+    // messages from before the log existed (resolving happens before Logman is created)
+    // isError, message
+    void TakeDeferredMessages(vector<pair<bool, string>>* store);
+
     const char* GetString(const char* section, const char* name, const char* default_value);
     const char* GetString(const char* section, const char* name, const char* def,
                           bool (*IsAllowed)(const char*));
@@ -32,5 +61,11 @@ class Config : public Module
 
    private:
     void LoadSettings(const char* path);
+    void ParseLine(string line, string* category);
+    void ResolveValues();
+    void LogMessage(bool isError, const char* format, ...);
+
     map<string, map<string, string> > settingsMap;
+    ConfigValues values;
+    vector<pair<bool, string>> deferredMessages;
 };
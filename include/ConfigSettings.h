@@ -0,0 +1,60 @@
+/*
+ * Every setting the client reads from config.ini, declared once
+ *
+ * Each entry is resolved (parsed, validated, defaulted) when Config loads, into a member of
+ * ConfigValues with the given name, which modules read through Config::Values().
+ *
+ * INT(member, section, name, default, validator)
+ * BOOL(member, section, name, default)         read as an int, nonzero is true
+ * STRING(member, section, name, default)
+ * INT_LIST(member, section, name)              comma separated, empty if missing
+ *
+ * Validators are bool (*)(i32) functions defined in Config.cpp.
+ */
+
+#pragma once
+
+#define CONFIG_SETTINGS(INT, BOOL, STRING, INT_LIST)                                             \
+    INT(videoWidth, "video", "width", 800, IsScreenDimension)                                    \
+    INT(videoHeight, "video", "height", 600, IsScreenDimension)                                  \
+    STRING(videoTitle, "video", "title", "Discretion2")                                          \
+    BOOL(videoVsync, "video", "vsync", true)                                                     \
+    INT(videoMaxFps, "video", "max_fps", 0, IsNonNegative)                                       \
+    BOOL(videoHeadless, "video", "headless", false)                                              \
+                                                                                                 \
+    INT(gameTicksPerSecond, "game", "ticks_per_second", 60, IsPositive)                          \
+    INT(gamePredictionSmoothMs, "game", "prediction_smooth_ms", 100, IsNonNegative)              \
+    INT(gamePredictionSnapPixels, "game", "prediction_snap_pixels", 48, IsPositive)              \
+                                                                                                 \
+    STRING(logFilename, "log", "filename", "log.txt")                                            \
+    STRING(logPrintLevel, "log", "print_level", "")                                              \
+                                                                                                 \
+    STRING(graphicsFolder, "graphics", "folder", "resources")                                    \
+    STRING(graphicsIconImageName, "graphics", "icon_image_name", "icon")                         \
+    STRING(graphicsNotFoundImageName, "graphics", "not_found_image_name", "not_found")           \
+                                                                                                 \
+    STRING(textFontFile, "text", "font_file", "source_han_sans.otf")                             \
+    INT(textFontSize, "text", "font_size", 12, IsFontSize)                                       \
+    BOOL(textUseBlendedFont, "text", "use_blended_font", true)                                   \
+                                                                                                 \
+    INT(chatMaxTypingBytes, "chat", "max_typing_bytes", 200, IsPositive)                         \
+    INT(chatBufferLines, "chat", "buffer_lines", 50, IsPositive)                                 \
+    INT(chatDisplayLines, "chat", "display_lines", 5, IsNonNegative)                             \
+                                                                                                 \
+    STRING(connectionUsername, "connection", "username", "Player")                               \
+    STRING(connectionPassword, "connection", "password", "1234")                                 \
+    STRING(connectionConnectAddr, "connection", "connect_addr", "127.0.0.1:5000")                \
+                                                                                                 \
+    INT(netProtocolVersion, "net", "protocol version", 0x1, AnyInt)                              \
+    INT(netEncryptionKey, "net", "encryption key", 0x1, AnyInt)                                  \
+    INT(netClientVersion, "net", "client version", 0x02, AnyInt)                                 \
+    INT(netConnectionRetryDelayMills, "net", "connection retry delay mills", 1000, IsPositive)   \
+    INT(netMaxConnectionAttempts, "net", "max connection attempts", 10, IsPositive)              \
+    INT(netMaxTimeWithoutData, "net", "max time without data", 10, IsPositive)                   \
+    INT(netMaxFileSizeBytes, "net", "max file size bytes", 4194304, IsPositive)                  \
+    INT(netReliableResendMills, "net", "reliable resend mills", 300, IsPositive)                 \
+    INT(netReliableWarnRetries, "net", "reliable warn retries", 5, IsPositive)                   \
+    INT(netReliableMaxRetries, "net", "reliable max retries", 10, IsPositive)                    \
+    STRING(netCaptureFile, "net", "capture file", "")                                            \
+                                                                                                 \
+    INT_LIST(packetsIgnoreGamePackets, "packets", "ignore game packets")
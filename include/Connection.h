@@ -44,6 +44,9 @@ class Connection : public Module
     string GetZoneDir();   // ends in '/' will mkdirs if it doesn't exist
     string GetArenaDir();  // ends in '/' will mkdirs if it doesn't exist
 
+    // maps shared by all zones, stored by content, ends in '/' will mkdirs if it doesn't exist
+    string GetMapStoreDir();
+
    private:
     shared_ptr<ConnectionData> data;
 };
@@ -47,6 +47,13 @@ enum TextColor
     Color_Pink,
 };
 
+// a wrapped line of text, as a byte range into the original utf8 string
+struct TextSpan
+{
+    u32 start;
+    u32 len;
+};
+
 // automatically-drawn text
 class DrawnText
 {
@@ -77,12 +84,20 @@ class DrawnImage
     void SetVisible(bool vis);
     void AdvanceAnimation(u32 mills);
 
+    // for swapping in an image once it's loaded
+    bool HasImage(shared_ptr<Image> i);
+    void RefreshImage();
+
    private:
+    void UpdateFrameSource();
+
     u32 lastFrameNum = 0;
     u32 animMsElapsed = 0;
     u32 animMs = 0;  // 0 = no animation
     u32 animFrameOffset = 0;
     u32 animNumFrames = 0;
+    bool hasCenter = false;  // SetCenterPosition() was called
+    i32 centerX = 0, centerY = 0;
 
     shared_ptr<GraphicsData> gd;
     shared_ptr<Image> image;
@@ -95,10 +110,24 @@ class Graphics : public Module
     Graphics(Client& c);
     ~Graphics();
 
-    void Render(i32 difMs);
+    // alpha is how far we are between the last two simulation steps (0 to 1)
+    void Render(i32 difMs, float alpha);
     void GetScreenSize(u32* w, u32* h);
     i32 GetFontHeight();
 
+    bool HasVsync();
+    i32 GetRefreshRate();
+
+    // headless mode (video::headless) creates no window or textures, nothing is actually drawn
+    bool IsHeadless();
+
+    // total frames rendered and objects drawn (counted in headless mode as well)
+    void GetDrawCounts(u64* frames, u64* draws);
+
+    // called at the start of each simulation step, map images are drawn interpolated between
+    // their position at the last call and their current position
+    void SaveInterpolationState();
+
     // text will keep getting drawn until object is disposed (wrapPixels = 0 means no wrap)
     // playerName can be null
     shared_ptr<DrawnText> MakeDrawnText(Layer layer, TextColor color, const char* utf8,
@@ -106,6 +135,9 @@ class Graphics : public Module
     void MakeDrawnChat(vector<shared_ptr<DrawnText>>& store, Layer layer, TextColor color,
                        i32 wrapPixels, const char* playerNameUtf8, const char* utf8);
 
+    // compute where MakeDrawnChat would break utf8 into lines (without rendering anything)
+    void WrapText(vector<TextSpan>& store, const char* utf8, i32 wrapPixels);
+
     // image will keep getting drawn until object is disposed
     // screen images are in absolute screen coordinates (the gauges)
     // map images are in map coordinates (other ships)
@@ -115,12 +147,26 @@ class Graphics : public Module
     shared_ptr<DrawnImage> MakeDrawnAnimation(Layer layer, shared_ptr<Animation> anim,
                                               bool isMapAnimation = false);
 
-    // will loop once
-    void MakeSingleDrawnAnimation(Layer layer, i32 x, i32 y, shared_ptr<Animation> anim);
+    // plays once, centered at x, y on the screen or the map (pooled, so it's cheap to make many)
+    void MakeSingleDrawnAnimation(Layer layer, i32 x, i32 y, shared_ptr<Animation> anim,
+                                  bool isMapAnimation = false);
 
+    // images load in the background: what's returned is a placeholder that draws nothing (with
+    // 1x1 frames) until the real image replaces it at the start of a later frame, which also
+    // resizes any drawn images made from it
+    // the same filename and frames give the same Image (and texture) while it's still in use, and
+    // the filename can leave off the extension
     shared_ptr<Image> LoadImage(const char* filename);
     shared_ptr<Image> LoadImage(const char* filename, u32 framesW, u32 framesH);
 
+    // decode an image file that's in memory (like the tileset in a .lvl), bytes are copied so they
+    // can be freed after the call, name is only for messages
+    shared_ptr<Image> LoadImageFromMemory(const char* name, const u8* bytes, i32 len,
+                                          u32 framesW, u32 framesH);
+
+    // an image from w * h rgba pixels (4 bytes each, in rows), pure black is transparent
+    shared_ptr<Image> MakeImageFromPixels(const char* name, i32 w, i32 h, const u8* rgba);
+
     shared_ptr<Animation> InitAnimation(shared_ptr<Image> i, u32 animMs, u32 animFrameOffset,
                                         u32 animNumFrames);
     shared_ptr<Animation> InitAnimation(shared_ptr<Image> i, u32 animMs);
@@ -128,6 +174,9 @@ class Graphics : public Module
     // call during draw loop
     void DrawImageFrame(shared_ptr<Image> i, i32 frame, i32 pixelX, i32 pixelY);
 
+    // call during draw loop, filled rectangles of one color in a single draw
+    void DrawRects(const SDL_Rect* rects, i32 count, TextColor color);
+
    private:
     shared_ptr<GraphicsData> data;
 };
@@ -17,6 +17,12 @@ enum LogLevel
     LOG_ERROR,
 };
 
+struct LogmanData;
+
+// Logging is asynchronous: the calling thread packs the message (format pointer and arguments)
+// into a lock-free ring, and a background thread formats and writes it. Formats must be string
+// literals, since only the pointer is kept. If the ring is full the message is dropped and
+// counted, rather than making the caller wait.
 class Logman : public Module
 {
    public:
@@ -31,12 +37,24 @@ class Logman : public Module
     // log an error and then exit
     void FatalError(const char* format, ...);
 
+    // wait until everything logged so far has been written
+    void Flush();
+
+    // messages lost because the ring was full
+    u64 GetDroppedCount();
+
     LogLevel logLevelSave = LOG_INFO;         // minimum log level for saving to the terminal
     LogLevel logLevelPrint = LOG_DRIVEL;      // minimum log level for printing
     LogLevel logLevelPrintStderr = LOG_INFO;  // minimum log level for printing to stderr
 
    private:
     FILE* f = nullptr;
+    shared_ptr<LogmanData> data;
+
     void LogHeader();
     void LogVaList(LogLevel l, const char* format, va_list args);
+
+    // background thread side
+    void WriterLoop();
+    bool WriteAvailable();
 };
@@ -3,6 +3,7 @@
 #include "Module.h"
 
 struct MapData;
+struct CollisionMap;  // dcollision.h
 
 unique_ptr<u8[]> ZlibDecompress(Client& c, const u8* src, int len, i32* decompressedLen);
 
@@ -15,7 +16,17 @@ class Map : public Module
 
     void SetMapPath(const char* filename);  // use nullptr to clear map
 
-    void DrawMap();
+    void DrawMap(float alpha);  // alpha is the render interpolation amount
+
+    // the radar (a minimap made when the map loads) with player dots, drawn at Layer_Gauges
+    void DrawRadar(float alpha);
+
+    // the tile at tile coordinates, 0 if it's empty, outside the map or there's no map
+    u8 GetTile(i32 x, i32 y);
+
+    // solid tiles of the current map, for the collision functions in dcollision.h (nullptr if
+    // there's no map)
+    const CollisionMap* GetCollisionMap();
 
    private:
     shared_ptr<MapData> data;
@@ -10,6 +10,8 @@
 #include "Module.h"
 #include "Packets.h"
 #include "Settings.h"
+#include <SDL2/SDL_net.h>
+#include <cstdio>
 
 const u8 RELIABLE_HEADER = 0x03;
 const u8 CORE_HEADER = 0x00;
@@ -17,6 +19,55 @@ const u8 CLUSTER_HEADER = 0x0E;
 
 struct NetData;
 
+// traffic counters, totals since the Net module was created
+struct NetStats
+{
+    static const i32 RTT_BUCKETS = 1000;  // 1 ms each, the last one holds everything above
+
+    u64 packetsSent = 0;
+    u64 packetsReceived = 0;
+    u64 bytesSent = 0;
+    u64 bytesReceived = 0;
+
+    u64 reliableSent = 0;    // reliable packets queued for sending
+    u64 reliableResent = 0;  // reliable retransmissions
+
+    // round trip times (send until ack) of reliable packets that were only sent once
+    u64 rttSamples = 0;
+    u32 rttHistogram[RTT_BUCKETS] = {};
+
+    // current values rather than totals, not summed by Add()
+    u32 reliableQueued = 0;    // reliable packets waiting for an ack
+    i32 syncRttMs = -1;        // round trip of the last sync ping, -1 before the first
+    i32 serverTimeOffset = 0;  // the amount of centiseconds the server is ahead of us
+
+    void RecordRtt(i32 ms);
+    i32 RttPercentile(double percent) const;  // -1 if there are no samples
+
+    // sum other into this
+    void Add(const NetStats* other);
+};
+
+// packet capture files (Net::Capture File in config.ini)
+enum CaptureDirection
+{
+    Capture_Received = 0,
+    Capture_Sent = 1,
+};
+
+struct CaptureRecord
+{
+    u64 microseconds;  // since the capture started
+    CaptureDirection direction;
+    vector<u8> data;  // the whole datagram
+};
+
+// read the file header, false if it's not a capture file (or a different version)
+bool ReadCaptureHeader(FILE* f);
+
+// false at the end of the file
+bool ReadCaptureRecord(FILE* f, CaptureRecord* store);
+
 class Net : public Module
 {
    public:
@@ -27,14 +78,28 @@ class Net : public Module
     void DisconnectSocket();
 
     void AddPacketHandler(const char* name, std::function<void(const PacketInstance*)> func);
+
+    // for packets that don't fit a template (like the variable length physics frames)
+    void AddRawPacketHandler(PacketType type, std::function<void(const u8*, i32)> func);
     void SendPacket(PacketInstance* packet);
     void SendReliablePacket(PacketInstance* packet);
 
+    // unreliable, for packets that don't fit a template (bytes are copied)
+    void SendRawPacket(const u8* bytes, i32 len);
+
     void ExpectStreamTransfer(std::function<void()> abortFunc,
                               std::function<void(i32, i32)> progressFunc);
     void PumpPacket(const u8* data, i32 len);
 
     const ArenaSettings* GetArenaSettings();
+    const NetStats* GetStats();
+
+    // the socket for the current connection (nullptr when disconnected), for select-style waiting
+    UDPsocket GetSocket();
+
+    // call before connecting to replay a capture: no socket is opened, received packets are
+    // given to PumpPacket instead, and everything sent is discarded
+    void StartReplay();
 
     // periodically called
     void ReceivePackets(i32 ms);
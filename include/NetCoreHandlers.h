@@ -7,6 +7,7 @@
 #include "Client.h"
 #include "Connection.h"
 #include "Map.h"
+#include "Net.h"
 #include <SDL/SDL.h>
 #include <vector>
 #include <list>
@@ -26,10 +27,12 @@ struct NetCoreHanders
 
             timesSent = 1;
             msUntilNextSend = resendMs;
+            sentTicks = SDL_GetTicks();
         }
 
         u32 ackId;
         vector<u8> data;
+        u32 sentTicks;  // for round trip time measurement
 
         i32 msUntilNextSend;
         i32 timesSent;
@@ -63,12 +66,13 @@ struct NetCoreHanders
     };
 
     Client& c;
-    i32 maxStreamLen = c.cfg->GetInt("Net", "Max File Size Bytes", 4194304);
-    i32 reliableResendTime = c.cfg->GetInt("Net", "Reliable Resend Mills", 300);
-    i32 reliableWarnRetries = c.cfg->GetInt("Net", "Reliable Warn Retries", 5);
-    i32 reliableMaxRetries = c.cfg->GetInt("Net", "Reliable Max Retries", 10);
+    i32 maxStreamLen = c.cfg->Values().netMaxFileSizeBytes;
+    i32 reliableResendTime = c.cfg->Values().netReliableResendMills;
+    i32 reliableWarnRetries = c.cfg->Values().netReliableWarnRetries;
+    i32 reliableMaxRetries = c.cfg->Values().netReliableMaxRetries;
 
     ArenaSettings arenaSettings;
+    NetStats stats;
 
     // huge chunk
     StreamData streamDataIn;
@@ -82,9 +86,6 @@ struct NetCoreHanders
     u32 nextIncomingReliableId = 0;
     u32 nextOutgoingReliableId = 0;
 
-    // timer sync
-    i32 serverTimeOffset = 0;  // the amount of centiseconds the server is ahead of us
-
     // map info
     vector<FileInformation> lvzInfo;
     FileInformation mapInfo;
@@ -129,6 +130,7 @@ struct NetCoreHanders
                 {
                     i->msUntilNextSend = reliableResendTime;
                     packetQueue->push_back(i->data);
+                    ++stats.reliableResent;
 
                     if (i->timesSent >= reliableWarnRetries)
                     {
@@ -161,6 +163,7 @@ struct NetCoreHanders
             (*packet)[RELIABLE_ID_OFFSET + x] = data[x];
 
         relPackets.push_back(QueuedReliablePacket(packet, id, reliableResendTime));
+        ++stats.reliableSent;
     }
 
     void ExpectStreamTransfer(std::function<void()> abortFunc,
@@ -409,6 +412,10 @@ struct NetCoreHanders
         {
             if (i->ackId == id)
             {
+                // resent packets are ambiguous (which copy was acked?), so they aren't measured
+                if (i->timesSent == 1)
+                    stats.RecordRtt(SDL_GetTicks() - i->sentTicks);
+
                 relPackets.erase(i);
                 break;
             }
@@ -437,6 +444,7 @@ struct NetCoreHanders
         // printf(":coreHandlers, got sync pong, time = %i, time/10=%i\n", util->getMilliseconds(),
         // myTime);
 
-        serverTimeOffset = (serverTime + roundTripCentiseconds / 2) - myTime;
+        stats.syncRttMs = roundTripCentiseconds * 10;
+        stats.serverTimeOffset = (serverTime + roundTripCentiseconds / 2) - myTime;
     };
 };
@@ -59,6 +59,10 @@ class Packets : public Module
 
     void PacketTemplateToRaw(PacketInstance* packet, bool reliable, vector<u8>* rawData);
 
+    // names of the templates loaded so far (templates get loaded when first used)
+    // incoming includes the core templates, which go both ways
+    void GetLoadedTemplateNames(vector<string>* incoming, vector<string>* outgoing);
+
    private:
     shared_ptr<PacketsData> data;
 };
@@ -0,0 +1,31 @@
+/*
+ * Performance overlay, toggled with F3 or ?perf
+ *
+ * Shows frame time percentiles, simulation steps and draws per frame, and network rates and the
+ * reliable round trip p50 over the last second, along with the reliable queue depth, server time
+ * offset and ping.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+struct PerfOverlayData;
+
+class PerfOverlay
+{
+   public:
+    PerfOverlay(Client& c);
+
+    // once per rendered frame, frameMs is the time since the last frame
+    void RecordFrame(double frameMs, i32 steps);
+
+    // once per simulation step, samples the network counters
+    void RecordStep();
+
+    void SetVisible(bool vis);
+    bool IsVisible();
+
+   private:
+    shared_ptr<PerfOverlayData> data;
+};
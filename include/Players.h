@@ -39,9 +39,19 @@ struct Player
     ShipType ship = Ship_Spec;
 
     PlayerPhysics physics;
+    PlayerPhysics prevPhysics;  // physics at the start of the current simulation step
+
+    // added when drawing (pixels * 10000), the part of a prediction correction not shown yet
+    i32 drawOffsetX = 0;
+    i32 drawOffsetY = 0;
 
     i32 GetXPixel();
     i32 GetYPixel();
+
+    // position interpolated between the last two simulation steps (alpha is 0 to 1)
+    i32 GetDrawXPixel(float alpha);
+    i32 GetDrawYPixel(float alpha);
+
     i32 GetXTile();
     i32 GetYTile();
     i32 GetRotFrame();
@@ -57,8 +67,15 @@ class Players : public Module
     shared_ptr<Player> GetPlayer(i32 pid);
     shared_ptr<Player> GetSelfPlayer(bool logErrors = true);
 
+    // every player in the arena (which includes self once it has entered), store is cleared first
+    void GetPlayers(vector<shared_ptr<Player>>* store);
+
+    // re-check every entry in the on-screen player list (it's normally updated per-event)
     void UpdatePlayerList();
 
+    // called at the start of each simulation step
+    void SaveInterpolationState();
+
    private:
     shared_ptr<PlayersModuleData> data;
 };
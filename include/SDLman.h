@@ -18,6 +18,10 @@ class SDLman : public Module
     void MainLoop();
     void Exit();
 
+    // advance the game by ms without polling events or rendering, for clients that are driven by
+    // an external loop (MainLoop does this itself)
+    void AdvanceState(i32 ms);
+
    private:
     shared_ptr<SDLmanData> data;
 };
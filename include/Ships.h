@@ -18,6 +18,9 @@ class Ships : Module
     Ships(Client& c);
     void AdvanceState(i32 difMs);
 
+    // called by Graphics during the draw loop, at the weapons layer
+    void DrawWeapons(float alpha);
+
     // completely in an arena
     void NowInGame();
 
@@ -12,6 +12,9 @@
 class Timer;
 struct TimersData;
 
+// identifies a pending single timer, so it can be cancelled before it runs
+typedef u64 TimerHandle;
+
 class Timers : public Module
 {
    public:
@@ -22,7 +25,11 @@ class Timers : public Module
     // SAVE THE RETURN VALUE OR YOUR TIMER WILL NEVER GET CALLED
     shared_ptr<Timer> PeriodicTimer(const char* name, i32 delayMs, std::function<void()> f);
 
-    void SingleTimer(i32 delayMs, std::function<void()> f);
+    // timer will run once after delayMs, the handle can be ignored if you never need to cancel it
+    TimerHandle SingleTimer(i32 delayMs, std::function<void()> f);
+
+    // returns false if the timer already ran or was already cancelled
+    bool CancelTimer(TimerHandle h);
 
     void AdvanceTime(i32 ms);
 
@@ -0,0 +1,62 @@
+/*
+ * Scoped tracing of where the frame time goes, exported as Chrome trace-event JSON (open the file
+ * in chrome://tracing or ui.perfetto.dev). Started and stopped in game with the ?trace command.
+ *
+ * TRACE_ZONE(name) records the time from that line until the end of the enclosing scope. Names
+ * are kept as pointers, so they must be string literals, or come from TraceName() if they're
+ * built at runtime. While tracing is off a zone is a single flag check.
+ *
+ * Each thread records into its own fixed size ring, which keeps the most recent zones.
+ */
+
+#pragma once
+
+#include "Compatibility.h"
+#include <atomic>
+#include <string>
+using namespace std;
+
+extern std::atomic<bool> traceEnabled;
+
+// clears anything recorded earlier
+void TraceStart();
+void TraceStop();
+
+// write what was recorded as trace-event JSON, call after TraceStop()
+// false if the file couldn't be written, numEvents is set to the number of zones written
+bool TraceWriteJson(const char* path, i32* numEvents);
+
+// a stable pointer for a zone name built at runtime, only call while tracing
+const char* TraceName(const string& name);
+
+// microseconds on the trace clock
+u64 TraceNowMicros();
+
+void TraceRecord(const char* name, u64 startMicros, u64 endMicros);
+
+class TraceZone
+{
+   public:
+    TraceZone(const char* name)
+    {
+        if (traceEnabled.load(std::memory_order_relaxed))
+        {
+            this->name = name;
+            startMicros = TraceNowMicros();
+        }
+    }
+
+    ~TraceZone()
+    {
+        if (name != nullptr)
+            TraceRecord(name, startMicros, TraceNowMicros());
+    }
+
+   private:
+    const char* name = nullptr;
+    u64 startMicros = 0;
+};
+
+#define TRACE_ZONE_CONCAT2(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT2(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_ZONE_CONCAT(traceZone, __LINE__)(name)
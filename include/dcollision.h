@@ -0,0 +1,280 @@
+/*
+ * Discretion 2 tile collision, header only
+ *
+ * These are shared between the as3 discretion2 physics module (C) and the client (C++), so both
+ * sides agree on what hits a wall.
+ *
+ * A CollisionMap is one solid bit per tile (128 KB for the 1024x1024 map). On top of it:
+ *
+ * - collisionMoveBodies moves square hitboxes (half side = ShipSettings::Radius, the way ships
+ *   collide in subspace) first along x and then along y, stopping each axis at the first solid
+ *   tile column or row the box would enter.
+ * - collisionRayMarch walks the tiles a point crosses (a DDA), for bullets and other projectiles.
+ *
+ * Both take arrays, so a whole frame's bodies or projectiles can be tested in one call.
+ */
+
+#ifndef DCOLLISION_H_
+#define DCOLLISION_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define COLLISION_MAP_TILES 1024
+#define COLLISION_TILE_PIXELS 16
+#define COLLISION_WORDS_PER_ROW (COLLISION_MAP_TILES / 32)
+
+// bodies are left this far (in pixels) from the wall they stop at
+#define COLLISION_SEPARATION 0.01f
+
+typedef struct CollisionMap
+{
+    uint32_t solid[COLLISION_MAP_TILES * COLLISION_WORDS_PER_ROW];  // bit x % 32 of word x / 32
+} CollisionMap;
+
+typedef struct CollisionBody
+{
+    float x, y;    // center, in pixels
+    float dx, dy;  // movement this step, in pixels
+    float radius;  // half the side of the hitbox in pixels, 0 for a point
+} CollisionBody;
+
+typedef struct CollisionResult
+{
+    float x, y;  // where the body ended up
+    int hitX;    // stopped by a wall while moving along x (so x velocity should bounce)
+    int hitY;
+} CollisionResult;
+
+typedef struct CollisionRay
+{
+    float x, y;    // start, in pixels
+    float dx, dy;  // movement this step, in pixels
+} CollisionRay;
+
+typedef struct CollisionRayHit
+{
+    int hit;
+    float t;           // fraction of the movement before the hit, 0-1 (1 if there was no hit)
+    int tileX, tileY;  // the tile that was hit
+    int normalX;       // -1, 0 or 1, the side of the tile that was hit
+    int normalY;
+} CollisionRayHit;
+
+// 1-161 are walls and 162-169 are doors (treated as closed), all solid
+// 170 flag, 171 safe zone, 172 goal, 173-175 fly over and 176-190 fly under aren't solid, and
+// neither is anything above 190 (those aren't drawn either)
+static inline int collisionIsSolidTileId(int tile)
+{
+    return tile >= 1 && tile <= 169;
+}
+
+static inline void collisionClear(CollisionMap *m)
+{
+    memset(m->solid, 0, sizeof(m->solid));
+}
+
+static inline void collisionSetTile(CollisionMap *m, int x, int y, int tile)
+{
+    uint32_t *word = &m->solid[y * COLLISION_WORDS_PER_ROW + (x >> 5)];
+    uint32_t bit = 1u << (x & 31);
+
+    if (collisionIsSolidTileId(tile))
+        *word |= bit;
+    else
+        *word &= ~bit;
+}
+
+// tile coordinates, everything outside of the map is solid
+static inline int collisionIsSolid(const CollisionMap *m, int x, int y)
+{
+    int rv = 1;
+
+    if ((unsigned)x < COLLISION_MAP_TILES && (unsigned)y < COLLISION_MAP_TILES)
+        rv = (m->solid[y * COLLISION_WORDS_PER_ROW + (x >> 5)] >> (x & 31)) & 1;
+
+    return rv;
+}
+
+// pixel to tile coordinate, rounding down for negative pixels too
+static inline int collisionTile(float pixel)
+{
+    int t = (int)(pixel / COLLISION_TILE_PIXELS);
+
+    if (t * COLLISION_TILE_PIXELS > pixel)
+        --t;
+
+    return t;
+}
+
+// any solid tile in column x, rows y1-y2
+static inline int collisionColumnSolid(const CollisionMap *m, int x, int y1, int y2)
+{
+    int rv = 0;
+
+    for (int y = y1; y <= y2 && !rv; ++y)
+        rv = collisionIsSolid(m, x, y);
+
+    return rv;
+}
+
+// any solid tile in row y, columns x1-x2
+static inline int collisionRowSolid(const CollisionMap *m, int y, int x1, int x2)
+{
+    int rv = 0;
+
+    for (int x = x1; x <= x2 && !rv; ++x)
+        rv = collisionIsSolid(m, x, y);
+
+    return rv;
+}
+
+// move the box centered at *pos (half side r) by d along one axis, the box covers tiles
+// otherLow-otherHigh on the other axis; returns 1 if a wall stopped it
+static inline int collisionMoveAxis(const CollisionMap *m, float *pos, float d, float r,
+                                    int otherLow, int otherHigh, int alongX)
+{
+    int hit = 0;
+
+    if (d > 0)
+    {
+        int from = collisionTile(*pos + r);
+        int to = collisionTile(*pos + r + d);
+
+        for (int t = from + 1; t <= to && !hit; ++t)
+        {
+            if (alongX ? collisionColumnSolid(m, t, otherLow, otherHigh)
+                       : collisionRowSolid(m, t, otherLow, otherHigh))
+            {
+                *pos = t * COLLISION_TILE_PIXELS - r - COLLISION_SEPARATION;
+                hit = 1;
+            }
+        }
+
+        if (!hit)
+            *pos += d;
+    }
+    else if (d < 0)
+    {
+        int from = collisionTile(*pos - r);
+        int to = collisionTile(*pos - r + d);
+
+        for (int t = from - 1; t >= to && !hit; --t)
+        {
+            if (alongX ? collisionColumnSolid(m, t, otherLow, otherHigh)
+                       : collisionRowSolid(m, t, otherLow, otherHigh))
+            {
+                *pos = (t + 1) * COLLISION_TILE_PIXELS + r + COLLISION_SEPARATION;
+                hit = 1;
+            }
+        }
+
+        if (!hit)
+            *pos += d;
+    }
+
+    return hit;
+}
+
+// move count bodies, stopping each at walls
+static inline void collisionMoveBodies(const CollisionMap *m, const CollisionBody *bodies,
+                                       CollisionResult *results, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const CollisionBody *b = &bodies[i];
+        CollisionResult *res = &results[i];
+        float r = b->radius;
+
+        res->x = b->x;
+        res->y = b->y;
+
+        res->hitX = collisionMoveAxis(m, &res->x, b->dx, r, collisionTile(res->y - r),
+                                      collisionTile(res->y + r), 1);
+
+        res->hitY = collisionMoveAxis(m, &res->y, b->dy, r, collisionTile(res->x - r),
+                                      collisionTile(res->x + r), 0);
+    }
+}
+
+// walk the tiles crossed by a ray, returns 1 if it hits a solid tile (including the one it
+// starts in) within its movement
+static inline int collisionRayMarch(const CollisionMap *m, const CollisionRay *ray,
+                                    CollisionRayHit *out)
+{
+    int tx = collisionTile(ray->x);
+    int ty = collisionTile(ray->y);
+    int stepX = ray->dx > 0 ? 1 : -1;
+    int stepY = ray->dy > 0 ? 1 : -1;
+
+    // t at the next tile boundary on each axis, and t per tile
+    const float NEVER = 2.0f;
+    float tMaxX = NEVER, tMaxY = NEVER, tDeltaX = NEVER, tDeltaY = NEVER;
+
+    if (ray->dx != 0)
+    {
+        float edge = (float)((tx + (stepX > 0 ? 1 : 0)) * COLLISION_TILE_PIXELS);
+        tMaxX = (edge - ray->x) / ray->dx;
+        tDeltaX = COLLISION_TILE_PIXELS / (ray->dx > 0 ? ray->dx : -ray->dx);
+    }
+
+    if (ray->dy != 0)
+    {
+        float edge = (float)((ty + (stepY > 0 ? 1 : 0)) * COLLISION_TILE_PIXELS);
+        tMaxY = (edge - ray->y) / ray->dy;
+        tDeltaY = COLLISION_TILE_PIXELS / (ray->dy > 0 ? ray->dy : -ray->dy);
+    }
+
+    float t = 0;
+    int normalX = 0, normalY = 0;
+
+    memset(out, 0, sizeof(*out));
+    out->t = 1.0f;
+
+    while (t <= 1.0f)
+    {
+        if (collisionIsSolid(m, tx, ty))
+        {
+            out->hit = 1;
+            out->t = t;
+            out->tileX = tx;
+            out->tileY = ty;
+            out->normalX = normalX;
+            out->normalY = normalY;
+            break;
+        }
+
+        if (tMaxX < tMaxY)
+        {
+            t = tMaxX;
+            tMaxX += tDeltaX;
+            tx += stepX;
+            normalX = -stepX;
+            normalY = 0;
+        }
+        else
+        {
+            t = tMaxY;
+            tMaxY += tDeltaY;
+            ty += stepY;
+            normalX = 0;
+            normalY = -stepY;
+        }
+    }
+
+    return out->hit;
+}
+
+// march count rays, returns how many hit something
+static inline int collisionRayMarchBatch(const CollisionMap *m, const CollisionRay *rays,
+                                         CollisionRayHit *hits, int count)
+{
+    int rv = 0;
+
+    for (int i = 0; i < count; ++i)
+        rv += collisionRayMarch(m, &rays[i], &hits[i]);
+
+    return rv;
+}
+
+#endif
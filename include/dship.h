@@ -0,0 +1,181 @@
+/*
+ * Discretion 2 ship movement, header only
+ *
+ * These are shared between the as3 discretion2 physics module (C) and the client (C++). The server
+ * moves each ship by the inputs it receives, and the client runs the very same steps on its own
+ * ship so it can move without waiting for the server (see ShipsData in the client).
+ *
+ * Everything is integer math in the units of the client's PlayerPhysics (pixels * 10000, pixels *
+ * 10000 per second, degrees * 10000), except for wall collision, which goes through dcollision.h.
+ * A step is one tick of input; ticks are SHIP_TICKS_PER_SECOND a second, and shipTickMs() hands
+ * out the 16 or 17 ms of each one so both sides agree on every step's length.
+ */
+
+#ifndef DSHIP_H_
+#define DSHIP_H_
+
+#include <stdint.h>
+
+#include "dcollision.h"
+
+#define SHIP_TICKS_PER_SECOND 60
+
+// input buttons, one bit each
+#define SHIP_INPUT_UP 0x01
+#define SHIP_INPUT_DOWN 0x02
+#define SHIP_INPUT_LEFT 0x04
+#define SHIP_INPUT_RIGHT 0x08
+
+#define SHIP_FULL_ROTATION (360 * 10000)
+#define SHIP_DIRECTIONS 40  // ships face one of 40 directions, the frames of their image
+
+typedef struct ShipState
+{
+    int32_t x, y;        // pixels * 10000
+    int32_t xvel, yvel;  // pixels * 10000 per second
+    int32_t rot;         // degrees * 10000, 0 is up, increasing clockwise
+} ShipState;
+
+// from the arena's ShipSettings, in its units
+typedef struct ShipParams
+{
+    int32_t rotation;  // 400 = a full rotation in one second
+    int32_t thrust;    // acceleration, 16 is about 200 pixels per second per second
+    int32_t speed;     // top speed, pixels per 10 seconds
+    int32_t radius;    // pixels from the center to the edge of the hitbox, 0 uses 14
+} ShipParams;
+
+// sin of each direction * 16384 (direction 0 is up)
+static const int32_t SHIP_DIRECTION_SIN[SHIP_DIRECTIONS] = {
+    0,      2563,   5063,   7438,   9630,   11585,  13255,  14598,  15582,  16182,
+    16384,  16182,  15582,  14598,  13255,  11585,  9630,   7438,   5063,   2563,
+    0,      -2563,  -5063,  -7438,  -9630,  -11585, -13255, -14598, -15582, -16182,
+    -16384, -16182, -15582, -14598, -13255, -11585, -9630,  -7438,  -5063,  -2563};
+
+// the length of a tick in ms, ticks 0-59 add up to exactly one second
+static inline int32_t shipTickMs(uint32_t tick)
+{
+    uint32_t t = tick % SHIP_TICKS_PER_SECOND;
+
+    return (int32_t)((t + 1) * 1000 / SHIP_TICKS_PER_SECOND - t * 1000 / SHIP_TICKS_PER_SECOND);
+}
+
+static inline int32_t shipDirection(int32_t rot)
+{
+    return (int32_t)((int64_t)rot * SHIP_DIRECTIONS / SHIP_FULL_ROTATION);
+}
+
+static inline uint32_t shipSqrt64(uint64_t n)
+{
+    uint64_t rv = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > n)
+        bit >>= 2;
+
+    while (bit != 0)
+    {
+        if (n >= rv + bit)
+        {
+            n -= rv + bit;
+            rv = (rv >> 1) + bit;
+        }
+        else
+            rv >>= 1;
+
+        bit >>= 2;
+    }
+
+    return (uint32_t)rv;
+}
+
+// advance a ship by one tick of input; m can be null (no walls)
+static inline void shipStep(const CollisionMap *m, ShipState *s, const ShipParams *p,
+                            unsigned buttons, int32_t ms)
+{
+    // rotate: rotation 400 is SHIP_FULL_ROTATION per second, so 9 per ms per unit
+    int32_t turn = 0;
+
+    if ((buttons & SHIP_INPUT_LEFT) && !(buttons & SHIP_INPUT_RIGHT))
+        turn = -1;
+    else if ((buttons & SHIP_INPUT_RIGHT) && !(buttons & SHIP_INPUT_LEFT))
+        turn = 1;
+
+    s->rot += turn * 9 * p->rotation * ms;
+    s->rot %= SHIP_FULL_ROTATION;
+
+    if (s->rot < 0)
+        s->rot += SHIP_FULL_ROTATION;
+
+    // thrust along the direction the ship is facing
+    int32_t forward = 0;
+
+    if ((buttons & SHIP_INPUT_UP) && !(buttons & SHIP_INPUT_DOWN))
+        forward = 1;
+    else if ((buttons & SHIP_INPUT_DOWN) && !(buttons & SHIP_INPUT_UP))
+        forward = -1;
+
+    if (forward != 0)
+    {
+        int32_t dir = shipDirection(s->rot);
+        int64_t accel = (int64_t)forward * p->thrust * 125 * ms;  // pixels * 10000 per second
+
+        s->xvel += (int32_t)(accel * SHIP_DIRECTION_SIN[dir] / 16384);
+        s->yvel -= (int32_t)(accel * SHIP_DIRECTION_SIN[(dir + SHIP_DIRECTIONS / 4) %
+                                                        SHIP_DIRECTIONS] / 16384);
+    }
+
+    // limit the speed, keeping the direction of travel
+    int64_t maxVel = (int64_t)p->speed * 1000;
+    uint64_t velSq = (uint64_t)((int64_t)s->xvel * s->xvel + (int64_t)s->yvel * s->yvel);
+
+    if (velSq > (uint64_t)(maxVel * maxVel))
+    {
+        int64_t vel = shipSqrt64(velSq);
+
+        s->xvel = (int32_t)(s->xvel * maxVel / vel);
+        s->yvel = (int32_t)(s->yvel * maxVel / vel);
+    }
+
+    // move, bouncing off walls
+    int32_t dx = (int32_t)((int64_t)s->xvel * ms / 1000);
+    int32_t dy = (int32_t)((int64_t)s->yvel * ms / 1000);
+
+    if (m == 0)
+    {
+        s->x += dx;
+        s->y += dy;
+    }
+    else if (dx != 0 || dy != 0)
+    {
+        CollisionBody body;
+        CollisionResult res;
+
+        body.x = s->x / 10000.0f;
+        body.y = s->y / 10000.0f;
+        body.dx = dx / 10000.0f;
+        body.dy = dy / 10000.0f;
+        body.radius = (float)(p->radius > 0 ? p->radius : 14);
+
+        collisionMoveBodies(m, &body, &res, 1);
+
+        // only replace the axes that hit, so open space keeps the exact integer position
+        if (res.hitX)
+        {
+            s->x = (int32_t)(res.x * 10000.0f);
+            s->xvel = -s->xvel;
+        }
+        else
+            s->x += dx;
+
+        if (res.hitY)
+        {
+            s->y = (int32_t)(res.y * 10000.0f);
+            s->yvel = -s->yvel;
+        }
+        else
+            s->y += dy;
+    }
+}
+
+#endif
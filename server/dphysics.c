@@ -1,11 +1,13 @@
 // Discretion 2 physics module
 
-#include <assert.h>
 #include <string.h>
 
 #include "asss.h"
+#include "dcollision.h"
 #include "dphysics_packets.h"
+#include "dship.h"
 #include "packets/pdata.h"
+#include "packets/ppk.h"
 #include "packets/types.h"
 
 local Imodman *mm = 0;
@@ -14,8 +16,28 @@ local Iarenaman *aman = 0;
 local Imainloop *ml = 0;
 local Iplayerdata *pd = 0;
 local Ilogman *log = 0;
+local Imapdata *mapdata = 0;
+local Iconfig *cfg = 0;
 
 local int adkey = 0;
+local int pdkey = 0;
+
+// ticks of input applied at most per packet, a client that falls further behind skips ahead
+#define MAX_CATCHUP_TICKS SHIP_TICKS_PER_SECOND
+
+// ticks a player can apply ahead of the server's clock, for packets that arrive in bursts
+#define TICK_BUDGET_ALLOWANCE (SHIP_TICKS_PER_SECOND / 5)
+
+// unreliable packets can't be split by the protocol, so frames are sent in parts of this size
+#define FRAME_PACKET_MAX_LEN 496
+
+// weapons are sent to a player if they're within this many pixels on both axes (more than half
+// of a big screen), up to a limit per frame
+#define WEAPON_VIEW_PIXELS 1024
+#define MAX_WEAPONS_PER_FRAME 256
+
+local const char *shipSections[8] = {"Warbird", "Javelin", "Spider",    "Leviathan",
+                                     "Terrier", "Weasel",  "Lancaster", "Shark"};
 
 local pthread_mutex_t dphysics_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define LOCK() pthread_mutex_lock(&dphysics_mutex)
@@ -30,21 +52,109 @@ typedef struct FrameData
     LinkedList weaponStateList;
 } FrameData;
 
+typedef struct Weapon
+{
+    u16 id;
+    int type;          // WEAPON_ in dphysics_packets.h
+    float x, y;        // pixels
+    float xvel, yvel;  // pixels per second
+    ticks_t expires;
+    int exploded;  // it hit a wall or a bomb ran out of time, it's sent in one more frame
+} Weapon;
+
 typedef struct ArenaData
 {
     u32 nextFrameNum;
+    CollisionMap *collision;  // solid tiles of the arena's map
+    u32 mapChecksum;          // of the map collision was built from
+    ShipParams shipParams[8];
+    int bulletSpeed[8];  // pixels per 10 seconds
+    int bombSpeed[8];
+    int bulletAliveTime;  // centiseconds
+    int bombAliveTime;
+
+    // live weapons, in an array since every one of them is moved and sent each frame
+    Weapon *weapons;
+    int numWeapons;
+    int maxWeapons;
+    u16 nextWeaponId;
+    ticks_t lastMoveTicks;
 } ArenaData;
 
+typedef struct PlayerData
+{
+    int hasInput;  // state is moved by the player's inputs
+    int ship;      // the ship state was started in
+    u32 lastTick;  // the last input tick applied to state
+    ShipState state;
+
+    // ticks may only be applied as fast as server time passes: the budget is in hundredths of a
+    // tick, and grows by SHIP_TICKS_PER_SECOND each centisecond up to TICK_BUDGET_ALLOWANCE
+    int tickBudget;
+    ticks_t budgetTime;  // when tickBudget was last grown
+} PlayerData;
+
+local void buildCollisionMap(Arena *a, CollisionMap *m)
+{
+    collisionClear(m);
+
+    for (int y = 0; y < COLLISION_MAP_TILES; ++y)
+        for (int x = 0; x < COLLISION_MAP_TILES; ++x)
+        {
+            int tile = mapdata->GetTile(a, x, y);
+
+            if (tile != 0)
+                collisionSetTile(m, x, y, tile);
+        }
+}
+
+local void loadArenaSettings(Arena *a, ArenaData *data)
+{
+    for (int s = 0; s < 8; ++s)
+    {
+        ShipParams *params = &data->shipParams[s];
+
+        params->rotation = cfg->GetInt(a->cfg, shipSections[s], "InitialRotation", 200);
+        params->thrust = cfg->GetInt(a->cfg, shipSections[s], "InitialThrust", 16);
+        params->speed = cfg->GetInt(a->cfg, shipSections[s], "InitialSpeed", 2000);
+        params->radius = cfg->GetInt(a->cfg, shipSections[s], "Radius", 0);
+
+        data->bulletSpeed[s] = cfg->GetInt(a->cfg, shipSections[s], "BulletSpeed", 2000);
+        data->bombSpeed[s] = cfg->GetInt(a->cfg, shipSections[s], "BombSpeed", 2000);
+    }
+
+    data->bulletAliveTime = cfg->GetInt(a->cfg, "Bullet", "BulletAliveTime", 550);
+    data->bombAliveTime = cfg->GetInt(a->cfg, "Bomb", "BombAliveTime", 8000);
+}
+
 local void initArenaData(Arena *a)
 {
     ArenaData *data = P_ARENA_DATA(a, adkey);
 
     data->nextFrameNum = 0;
+    loadArenaSettings(a, data);
+
+    data->weapons = 0;
+    data->numWeapons = 0;
+    data->maxWeapons = 0;
+    data->nextWeaponId = 0;
+    data->lastMoveTicks = current_ticks();
+
+    data->collision = amalloc(sizeof(CollisionMap));
+    buildCollisionMap(a, data->collision);
+    data->mapChecksum = mapdata->GetChecksum(a, 0);
 }
 
 local void deinitArenaData(Arena *a)
 {
-    // ArenaData *data = P_ARENA_DATA(a, adkey);
+    ArenaData *data = P_ARENA_DATA(a, adkey);
+
+    afree(data->collision);
+    data->collision = 0;
+
+    afree(data->weapons);
+    data->weapons = 0;
+    data->numWeapons = data->maxWeapons = 0;
 
     // LLFree(&data->frames);
 }
@@ -86,83 +196,395 @@ local void deinitFrameData(FrameData *fd)
     LLEmpty(&fd->weaponStateList);
 }
 
+// read count bits from the input bit stream, returns -1 past the end
+local int readInputBits(const byte *bits, int numBytes, int *bitOffset, int count)
+{
+    int rv = 0;
+
+    for (int i = 0; i < count && rv != -1; ++i, ++*bitOffset)
+    {
+        if (*bitOffset / 8 >= numBytes)
+            rv = -1;
+        else if (bits[*bitOffset / 8] & (1 << (*bitOffset % 8)))
+            rv |= 1 << i;
+    }
+
+    return rv;
+}
+
+// decode a C2S_DISC2_INPUT packet into buttons (index 0 is newestTick), returns 0 if malformed
+local int decodeInput(const byte *pkt, int len, InputHeader *header,
+                      int buttons[INPUT_PACKET_MAX_TICKS])
+{
+    int rv = 0;
+
+    if (len >= (int)sizeof(InputHeader))
+    {
+        memcpy(header, pkt, sizeof(InputHeader));
+
+        if (header->numTicks >= 1 && header->numTicks <= INPUT_PACKET_MAX_TICKS)
+        {
+            const byte *bits = pkt + sizeof(InputHeader);
+            int numBytes = len - sizeof(InputHeader);
+            int bitOffset = 0;
+
+            buttons[0] = readInputBits(bits, numBytes, &bitOffset, 4);
+            rv = buttons[0] != -1;
+
+            for (int i = 1; i < header->numTicks && rv; ++i)
+            {
+                int changed = readInputBits(bits, numBytes, &bitOffset, 1);
+
+                if (changed == 1)
+                    buttons[i] = readInputBits(bits, numBytes, &bitOffset, 4);
+                else
+                    buttons[i] = changed == 0 ? buttons[i - 1] : -1;
+
+                rv = buttons[i] != -1;
+            }
+        }
+    }
+
+    return rv;
+}
+
+local void startShipState(Player *p, PlayerData *data)
+{
+    data->hasInput = 1;
+    data->ship = p->p_ship;
+    data->state.x = p->position.x * 10000;
+    data->state.y = p->position.y * 10000;
+    data->state.xvel = p->position.xspeed * 1000;
+    data->state.yvel = p->position.yspeed * 1000;
+    data->state.rot = p->position.rotation * (SHIP_FULL_ROTATION / SHIP_DIRECTIONS);
+    data->tickBudget = TICK_BUDGET_ALLOWANCE * 100;
+    data->budgetTime = current_ticks();
+}
+
+local void growTickBudget(PlayerData *data)
+{
+    ticks_t now = current_ticks();
+    int elapsed = TICK_DIFF(now, data->budgetTime);
+
+    if (elapsed > 0)
+    {
+        // capped before multiplying, so a long pause can't overflow it
+        if (elapsed > TICK_BUDGET_ALLOWANCE * 100)
+            elapsed = TICK_BUDGET_ALLOWANCE * 100;
+
+        data->tickBudget += elapsed * SHIP_TICKS_PER_SECOND;
+
+        if (data->tickBudget > TICK_BUDGET_ALLOWANCE * 100)
+            data->tickBudget = TICK_BUDGET_ALLOWANCE * 100;
+
+        data->budgetTime = now;
+    }
+}
+
+// move the player's ship by the ticks of input it hasn't been moved by yet
 local void ppk(Player *p, byte *pkt, int len)
 {
+    InputHeader header;
+    int buttons[INPUT_PACKET_MAX_TICKS];
+
+    if (!decodeInput(pkt, len, &header, buttons))
+    {
+        log->LogP(L_MALICIOUS, "dphysics", p, "bad input packet len=%i", len);
+        return;
+    }
+
     LOCK();
-    // struct C2SPosition *pos = (struct C2SPosition *)pkt;
+
+    PlayerData *data = PPDATA(p, pdkey);
+    Arena *a = p->arena;
+    u32 oldestTick = header.newestTick - (header.numTicks - 1);
+
+    if (a == 0 || p->p_ship == SHIP_SPEC)
+        data->hasInput = 0;
+    else
+    {
+        ArenaData *ad = P_ARENA_DATA(a, adkey);
+        const ShipParams *params = &ad->shipParams[p->p_ship];
+
+        if (!data->hasInput || data->ship != p->p_ship)
+        {
+            startShipState(p, data);
+            data->lastTick = oldestTick - 1;
+        }
+
+        if ((i32)(header.newestTick - data->lastTick) > MAX_CATCHUP_TICKS)
+            data->lastTick = header.newestTick - MAX_CATCHUP_TICKS;
+
+        growTickBudget(data);
+
+        // ticks at or before lastTick were already applied (by an earlier, redundant packet),
+        // ticks past the budget are running ahead of server time and wait for a later packet
+        while ((i32)(header.newestTick - data->lastTick) > 0 && data->tickBudget >= 100)
+        {
+            data->tickBudget -= 100;
+
+            u32 tick = ++data->lastTick;
+            u32 age = header.newestTick - tick;
+
+            // ticks lost before this packet's oldest are guessed to have its oldest input
+            int b = age < header.numTicks ? buttons[age] : buttons[header.numTicks - 1];
+
+            shipStep(ad->collision, &data->state, params, b, shipTickMs(tick));
+        }
+
+        p->position.x = data->state.x / 10000;
+        p->position.y = data->state.y / 10000;
+        p->position.xspeed = data->state.xvel / 1000;
+        p->position.yspeed = data->state.yvel / 1000;
+        p->position.rotation = shipDirection(data->state.rot);
+    }
+
+    UNLOCK();
+}
+
+local int isBomb(int type)
+{
+    return type == WEAPON_BOMB || type == WEAPON_PROXBOMB || type == WEAPON_THOR;
+}
+
+// CB_PPK, weapons fired by any player are tracked so they can be sent in frames
+local void weaponFired(Player *p, const struct C2SPosition *pos)
+{
+    int type = pos->weapon.type;
+    Arena *a = p->arena;
+
+    if (type < WEAPON_BULLET || type > WEAPON_THOR || a == 0 || p->p_ship == SHIP_SPEC)
+        return;
+
+    LOCK();
+
+    ArenaData *ad = P_ARENA_DATA(a, adkey);
+
+    if (ad->numWeapons == ad->maxWeapons)
+    {
+        ad->maxWeapons = ad->maxWeapons == 0 ? 64 : ad->maxWeapons * 2;
+        ad->weapons = arealloc(ad->weapons, ad->maxWeapons * sizeof(Weapon));
+    }
+
+    Weapon *w = &ad->weapons[ad->numWeapons++];
+    int isBullet = type == WEAPON_BULLET || type == WEAPON_BOUNCEBULLET || type == WEAPON_BURST;
+    int speed = 0;  // repels and decoys move with the ship
+
+    if (type == WEAPON_BULLET || type == WEAPON_BOUNCEBULLET)
+        speed = ad->bulletSpeed[p->p_ship];
+    else if (isBomb(type))
+        speed = ad->bombSpeed[p->p_ship];
+
+    int dir = pos->rotation % SHIP_DIRECTIONS;
+    int sinDir = SHIP_DIRECTION_SIN[dir];
+    int cosDir = SHIP_DIRECTION_SIN[(dir + SHIP_DIRECTIONS / 4) % SHIP_DIRECTIONS];
+
+    w->id = ad->nextWeaponId++;
+    w->type = type;
+    w->x = pos->x;
+    w->y = pos->y;
+    w->xvel = (pos->xspeed + speed * sinDir / 16384.0f) / 10.0f;
+    w->yvel = (pos->yspeed - speed * cosDir / 16384.0f) / 10.0f;
+    w->expires = TICK_MAKE(current_ticks() + (isBullet ? ad->bulletAliveTime : ad->bombAliveTime));
+    w->exploded = 0;
+
     UNLOCK();
 }
 
-// allocate memory for frame packet, return it, and set size parameter
-local byte *makeFramePacket(FrameData *fd, u32 *size)
+// drop the weapons that exploded or ran out of time, and move the rest up to now
+local void moveWeapons(ArenaData *ad)
+{
+    ticks_t now = current_ticks();
+    float seconds = TICK_DIFF(now, ad->lastMoveTicks) / 100.0f;
+    int kept = 0;
+
+    ad->lastMoveTicks = now;
+
+    for (int i = 0; i < ad->numWeapons; ++i)
+    {
+        Weapon *w = &ad->weapons[i];
+
+        if (w->exploded)
+            continue;
+
+        // bombs go off when they run out of time, everything else just disappears
+        if (TICK_GT(now, w->expires))
+        {
+            if (isBomb(w->type))
+            {
+                w->exploded = 1;
+                ad->weapons[kept++] = *w;
+            }
+
+            continue;
+        }
+
+        CollisionRay ray;
+        CollisionRayHit hit;
+
+        ray.x = w->x;
+        ray.y = w->y;
+        ray.dx = w->xvel * seconds;
+        ray.dy = w->yvel * seconds;
+
+        if (collisionRayMarch(ad->collision, &ray, &hit))
+        {
+            w->x += ray.dx * hit.t;
+            w->y += ray.dy * hit.t;
+
+            if (w->type == WEAPON_BOUNCEBULLET && (hit.normalX != 0 || hit.normalY != 0))
+            {
+                // nudged back out of the wall, the rest of this step's movement is lost
+                w->x += hit.normalX * COLLISION_SEPARATION;
+                w->y += hit.normalY * COLLISION_SEPARATION;
+
+                if (hit.normalX != 0)
+                    w->xvel = -w->xvel;
+                else
+                    w->yvel = -w->yvel;
+            }
+            else
+                w->exploded = 1;
+        }
+        else
+        {
+            w->x += ray.dx;
+            w->y += ray.dy;
+        }
+
+        ad->weapons[kept++] = *w;
+    }
+
+    ad->numWeapons = kept;
+}
+
+// a frame packet being filled, frames bigger than one packet are split over several
+typedef struct FramePart
+{
+    u32 frameNum;
+    int numPidStates;  // in this part
+    int numPlayerStates;
+    int numWeaponStates;
+    byte packet[FRAME_PACKET_MAX_LEN];
+    int len;
+    int numSent;  // parts of this frame already sent
+} FramePart;
+
+local void startFramePart(FramePart *part)
+{
+    part->numPidStates = 0;
+    part->numPlayerStates = 0;
+    part->numWeaponStates = 0;
+    part->len = sizeof(FrameHeader);
+}
+
+local void sendFramePart(Player *p, FramePart *part)
 {
     FrameHeader header;
     header.packetType = S2C_DISC2_FRAME;
-    header.frameNum = fd->frameNum;
+    header.frameNum = part->frameNum;
+    header.numPidStates = part->numPidStates;
+    header.numPlayerStates = part->numPlayerStates;
+    header.numWeaponStates = part->numWeaponStates;
+
+    memcpy(part->packet, &header, sizeof(FrameHeader));
+    net->SendToOne(p, part->packet, part->len, NET_UNRELIABLE);
 
-    // Note: LLCount is not the most efficient function...
-    header.numPidStates = LLCount(&fd->pidStateList);
-    header.numPlayerStates = LLCount(&fd->playerStateList);
-    header.numWeaponStates = LLCount(&fd->weaponStateList);
+    ++part->numSent;
+    startFramePart(part);
+}
+
+// append an item, count is the part's count of its type
+local void addToFramePart(Player *p, FramePart *part, const void *item, int size, int *count)
+{
+    if (part->len + size > FRAME_PACKET_MAX_LEN)
+        sendFramePart(p, part);
 
-    *size = sizeof(FrameHeader) + header.numPidStates * sizeof(PidState) +
-            header.numPlayerStates * sizeof(PlayerState) +
-            header.numWeaponStates * sizeof(WeaponState);
+    memcpy(part->packet + part->len, item, size);
+    part->len += size;
+    ++*count;
+}
 
-    byte *rv = amalloc(*size);
-    byte *curOffset = rv;
+// only the weapons near a player are sent to it, spectators (whose position the server doesn't
+// know) get the first ones up to the limit
+local int isWeaponVisible(Player *p, const WeaponState *ws)
+{
+    int dx = (int)ws->xpixel - p->position.x;
+    int dy = (int)ws->ypixel - p->position.y;
 
-    memcpy(curOffset, &header, sizeof(FrameHeader));
-    curOffset += sizeof(FrameHeader);
+    return p->p_ship == SHIP_SPEC || (dx >= -WEAPON_VIEW_PIXELS && dx <= WEAPON_VIEW_PIXELS &&
+                                      dy >= -WEAPON_VIEW_PIXELS && dy <= WEAPON_VIEW_PIXELS);
+}
 
+// send fd to p, split into as many packets as it takes (each a frame with the same frameNum)
+local void sendFrameData(Player *p, FrameData *fd)
+{
+    FramePart part;
     Link *link = 0;
+    int numWeapons = 0;
+
+    part.frameNum = fd->frameNum;
+    part.numSent = 0;
+    startFramePart(&part);
 
-    // copy pid state
-    PidState *curPidState = 0;
+    PidState *pid = 0;
 
-    FOR_EACH(&fd->pidStateList, curPidState, link)
+    FOR_EACH(&fd->pidStateList, pid, link)
     {
-        memcpy(curOffset, curPidState, sizeof(PidState));
-        curOffset += sizeof(PidState);
+        addToFramePart(p, &part, pid, sizeof(PidState), &part.numPidStates);
     }
 
-    // copy player state
-    PlayerState *curPlayerState = 0;
+    PlayerState *ps = 0;
 
-    FOR_EACH(&fd->playerStateList, curPlayerState, link)
+    FOR_EACH(&fd->playerStateList, ps, link)
     {
-        memcpy(curOffset, curPlayerState, sizeof(PlayerState));
-        curOffset += sizeof(PlayerState);
+        addToFramePart(p, &part, ps, sizeof(PlayerState), &part.numPlayerStates);
     }
 
-    // copy weapon state
-    WeaponState *curWeaponState = 0;
+    WeaponState *ws = 0;
 
-    FOR_EACH(&fd->weaponStateList, curWeaponState, link)
+    FOR_EACH(&fd->weaponStateList, ws, link)
     {
-        memcpy(curOffset, curWeaponState, sizeof(WeaponState));
-        curOffset += sizeof(WeaponState);
+        if (numWeapons < MAX_WEAPONS_PER_FRAME && isWeaponVisible(p, ws))
+        {
+            addToFramePart(p, &part, ws, sizeof(WeaponState), &part.numWeaponStates);
+            ++numWeapons;
+        }
     }
 
-    assert(curOffset == rv + *size);
-
-    return rv;
+    if (part.len > (int)sizeof(FrameHeader) || part.numSent == 0)
+        sendFramePart(p, &part);
 }
 
 local void sendFrameDataToAllPlayers(FrameData *fd, Arena *arena)
 {
-    u32 size = 0;
-    byte *packet = makeFramePacket(fd, &size);
     Link *link = 0;
     Player *p = 0;
 
     FOR_EACH_PLAYER_IN_ARENA(p, arena)
     {
         if (p->type == T_DISC2)
-            net->SendToOne(p, packet, size, NET_UNRELIABLE);
+        {
+            sendFrameData(p, fd);
+
+            PlayerData *data = PPDATA(p, pdkey);
+
+            if (data->hasInput)
+            {
+                SelfState self;
+
+                self.packetType = S2C_DISC2_SELF;
+                self.inputTick = data->lastTick;
+                self.x = data->state.x;
+                self.y = data->state.y;
+                self.xvel = data->state.xvel;
+                self.yvel = data->state.yvel;
+                self.rot = data->state.rot;
+
+                net->SendToOne(p, (byte *)&self, sizeof(self), NET_UNRELIABLE);
+            }
+        }
     }
-
-    afree(packet);
 }
 
 local void populateFrameData(FrameData *fd, Arena *arena, ArenaData *arenaData)
@@ -191,12 +613,27 @@ local void populateFrameData(FrameData *fd, Arena *arena, ArenaData *arenaData)
         ps->rot = p->position.rotation;
         ps->xpixel = p->position.x;
         ps->ypixel = p->position.y;
+        ps->xvel = p->position.xspeed;
+        ps->yvel = p->position.yspeed;
         LLAdd(&fd->playerStateList, ps);
     }
 
     pd->Unlock();
 
-    // need to populate weapons as well
+    for (int i = 0; i < arenaData->numWeapons; ++i)
+    {
+        const Weapon *w = &arenaData->weapons[i];
+        WeaponState *ws = amalloc(sizeof(WeaponState));
+
+        ws->id = w->id;
+        ws->type = w->type;
+        ws->xpixel = (int)w->x;
+        ws->ypixel = (int)w->y;
+        ws->exploded = w->exploded;
+        ws->xvel = (i16)(w->xvel * 10);
+        ws->yvel = (i16)(w->yvel * 10);
+        LLAdd(&fd->weaponStateList, ws);
+    }
 }
 
 local int FrameTimer(void *dummy)
@@ -211,6 +648,7 @@ local int FrameTimer(void *dummy)
         initFrameData(&fd);
         ArenaData *arenaData = P_ARENA_DATA(arena, adkey);
 
+        moveWeapons(arenaData);
         populateFrameData(&fd, arena, arenaData);
         sendFrameDataToAllPlayers(&fd, arena);
 
@@ -229,7 +667,10 @@ local void paction(Player *p, int action, Arena *arena)
 
     if (action == PA_ENTERARENA || action == PA_LEAVEARENA)
     {
-        // ArenaData *data = P_ARENA_DATA(arena, adkey);
+        // the client starts counting ticks again in a new arena
+        PlayerData *data = PPDATA(p, pdkey);
+
+        data->hasInput = 0;
     }
 
     UNLOCK();
@@ -243,6 +684,20 @@ local void aaction(Arena *arena, int action)
     {
         initArenaData(arena);
     }
+    else if (action == AA_CONFCHANGED)
+    {
+        ArenaData *data = P_ARENA_DATA(arena, adkey);
+        u32 checksum = mapdata->GetChecksum(arena, 0);
+
+        loadArenaSettings(arena, data);
+
+        // a new map (the arena's level setting can change), ships and weapons need its walls
+        if (checksum != data->mapChecksum)
+        {
+            buildCollisionMap(arena, data->collision);
+            data->mapChecksum = checksum;
+        }
+    }
     else if (action == AA_DESTROY)
     {
         deinitArenaData(arena);
@@ -263,19 +718,26 @@ EXPORT int MM_dphysics(int action, Imodman *mm_, Arena *arena)
         ml = mm->GetInterface(I_MAINLOOP, ALLARENAS);
         pd = mm->GetInterface(I_PLAYERDATA, ALLARENAS);
         log = mm->GetInterface(I_LOGMAN, ALLARENAS);
+        mapdata = mm->GetInterface(I_MAPDATA, ALLARENAS);
+        cfg = mm->GetInterface(I_CONFIG, ALLARENAS);
 
-        if (!net || !aman || !ml || !pd || !log)
+        if (!net || !aman || !ml || !pd || !log || !mapdata || !cfg)
             return MM_FAIL;
 
         adkey = aman->AllocateArenaData(sizeof(ArenaData));
         if (adkey == -1)
             return MM_FAIL;
 
-        net->AddPacket(C2S_POSITION, ppk);
+        pdkey = pd->AllocatePlayerData(sizeof(PlayerData));
+        if (pdkey == -1)
+            return MM_FAIL;
+
+        net->AddPacket(C2S_DISC2_INPUT, ppk);
 
         ml->SetTimer(FrameTimer, 0, 1000 / 60, NULL, NULL);
 
         mm->RegCallback(CB_PLAYERACTION, paction, ALLARENAS);
+        mm->RegCallback(CB_PPK, weaponFired, ALLARENAS);
         mm->RegCallback(CB_ARENAACTION, aaction, ALLARENAS);
 
         rv = MM_OK;
@@ -283,10 +745,12 @@ EXPORT int MM_dphysics(int action, Imodman *mm_, Arena *arena)
     else if (action == MM_UNLOAD)
     {
         mm->UnregCallback(CB_ARENAACTION, aaction, ALLARENAS);
+        mm->UnregCallback(CB_PPK, weaponFired, ALLARENAS);
         mm->UnregCallback(CB_PLAYERACTION, paction, ALLARENAS);
 
         ml->ClearTimer(FrameTimer, NULL);
-        net->RemovePacket(C2S_POSITION, ppk);
+        net->RemovePacket(C2S_DISC2_INPUT, ppk);
+        pd->FreePlayerData(pdkey);
         aman->FreeArenaData(adkey);
 
         mm->ReleaseInterface(pd);
@@ -294,6 +758,8 @@ EXPORT int MM_dphysics(int action, Imodman *mm_, Arena *arena)
         mm->ReleaseInterface(aman);
         mm->ReleaseInterface(ml);
         mm->ReleaseInterface(log);
+        mm->ReleaseInterface(mapdata);
+        mm->ReleaseInterface(cfg);
 
         rv = MM_OK;
     }
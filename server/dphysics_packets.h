@@ -13,9 +13,13 @@
 #pragma pack(push, 1)
 
 #define S2C_DISC2_FRAME 0xD0
+#define C2S_DISC2_INPUT 0xD1
+#define S2C_DISC2_SELF 0xD2
 
 // Frame Header is the beginning of a frame packet
 // It is followed by a variable number of other structs, in the same order as in the header
+// A frame that doesn't fit in one packet is sent as several, each with its own header (counting
+// what's in that packet) and the same frameNum
 typedef struct FrameHeader
 {
     u8 packetType;  // S2C_DISC2_FRAME = 0xD0
@@ -41,16 +45,62 @@ typedef struct PlayerState
     unsigned xpixel : 14;  // 0-1024 * 16
     unsigned ypixel : 14;  // 0-1024 * 16
     unsigned exploded : 1;
+    i16 xvel;  // pixels per 10 seconds
+    i16 yvel;
 } PlayerState;
 
+// sent after each frame to a client whose ship the server moves by its inputs, with the exact
+// state (PlayerState is rounded) for that client's prediction to replay its later inputs from
+typedef struct SelfState
+{
+    u8 packetType;  // S2C_DISC2_SELF = 0xD2
+    u32 inputTick;  // the last of the player's input ticks that the server applied
+    i32 x, y;       // the ShipState after that tick, see dship.h
+    i32 xvel, yvel;
+    i32 rot;
+} SelfState;
+
+// weapon types, the same values as the W_ constants in ppk.h
+#define WEAPON_BULLET 1
+#define WEAPON_BOUNCEBULLET 2
+#define WEAPON_BOMB 3
+#define WEAPON_PROXBOMB 4
+#define WEAPON_REPEL 5
+#define WEAPON_DECOY 6
+#define WEAPON_BURST 7
+#define WEAPON_THOR 8
+
+// every frame has each live weapon near the player it's sent to, a weapon that's missing has run
+// out of time or gone out of view
 typedef struct WeaponState
 {
-    unsigned type : 4;     // one of the W_ constants in ppk.h
+    u16 id;                // stays the same for the weapon's life, so the client can follow it
+    unsigned type : 4;     // WEAPON_ above
     unsigned xpixel : 14;  // 0-1024 * 16
     unsigned ypixel : 14;  // 0-1024 * 16
-    unsigned exploded : 1;
+    unsigned exploded : 1;  // it hit something, this is the last frame it's in
+    i16 xvel;               // pixels per 10 seconds
+    i16 yvel;
 } WeaponState;
 
+// Input is sent unreliably every tick, and each packet repeats the inputs of the ticks before it
+// (up to INPUT_PACKET_MAX_TICKS in all), so a lost packet's inputs still arrive with the next one
+// without waiting for a resend. The server skips the ticks it has already applied.
+//
+// After the header is a bit stream (starting at the lowest bit of each byte), newest tick first:
+// 4 bits of buttons (SHIP_INPUT_ in dship.h) for newestTick, then for each older tick either a 0
+// bit (same buttons as the tick after it) or a 1 bit followed by its 4 bits of buttons.
+typedef struct InputHeader
+{
+    u8 packetType;  // C2S_DISC2_INPUT = 0xD1
+    u32 newestTick;
+    u8 numTicks;  // 1 - INPUT_PACKET_MAX_TICKS
+} InputHeader;
+
+#define INPUT_PACKET_MAX_TICKS 32
+#define INPUT_PACKET_MAX_LEN \
+    (sizeof(InputHeader) + (4 + (INPUT_PACKET_MAX_TICKS - 1) * 5 + 7) / 8)
+
 #pragma pack(pop)
 
 #endif
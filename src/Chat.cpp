@@ -8,6 +8,13 @@
 #include <set>
 using namespace std;
 
+// one wrapped line of the text being typed, cached so only edited lines get re-rendered
+struct TypingLine
+{
+    TextSpan span;  // byte range in curTextUtf8
+    shared_ptr<DrawnText> drawn;
+};
+
 class ChatData
 {
    public:
@@ -23,7 +30,8 @@ class ChatData
 
     bool escState = false;
 
-    vector<shared_ptr<DrawnText>> curTextLines;
+    vector<TypingLine> typingLines;
+    TextColor typingColor = Color_Grey;
     deque<shared_ptr<DrawnText>> chatBufferLines;
 
     map<u8, ChatType> prefixMap = {
@@ -44,7 +52,9 @@ class ChatData
 
     void UpdateTypingText();
     ChatType GetTypingChatType();
+    TextColor GetTypingColor();
     void UpdateChatLineVisuals();
+    void UpdateTypingLineVisual(u32 index);
     bool CheckInternalCommand(const char* textUtf8);
 
     std::function<void(const PacketInstance*)> handleIncomingChat = [this](const PacketInstance* pi)
@@ -88,9 +98,9 @@ class ChatData
 
 Chat::Chat(Client& c) : Module(c), data(make_shared<ChatData>(c))
 {
-    data->maxTypingBytes = c.cfg->GetInt("Chat", "max_typing_bytes", 200);
-    data->maxBufferLines = c.cfg->GetInt("Chat", "buffer_lines", 50);
-    data->displayLines = c.cfg->GetInt("Chat", "display_lines", 5);
+    data->maxTypingBytes = c.cfg->Values().chatMaxTypingBytes;
+    data->maxBufferLines = c.cfg->Values().chatBufferLines;
+    data->displayLines = c.cfg->Values().chatDisplayLines;
 
     c.graphics->GetScreenSize(&data->screenW, &data->screenH);
 
@@ -246,24 +256,97 @@ void Chat::AddInternalCommand(const char* command, std::function<void(const char
     }
 }
 
+TextColor ChatData::GetTypingColor()
+{
+    ChatType type = GetTypingChatType();
+    TextColor col = Color_Grey;
+
+    if (type != Chat_Public)  // special case when they are sending a public message
+        col = chatColorMap.find(type)->second;
+
+    return col;
+}
+
+// Typing only ever changes the end of curTextUtf8, so the wrapped lines before the cursor are
+// stable. We re-wrap starting one line before the cursor line (a backspace can let the last line
+// rejoin the previous one) and only re-render the lines whose text actually changed.
 void ChatData::UpdateTypingText()
 {
+    u32 oldLineCount = typingLines.size();
+    TextColor col = GetTypingColor();
+    u32 firstChanged = 0;
+
     if (curTextUtf8.length() == 0)
-        curTextLines.clear();
+        typingLines.clear();
     else
     {
-        ChatType type = GetTypingChatType();
-        TextColor col = Color_Grey;
+        u32 relayoutLine = 0;
+
+        if (col != typingColor)
+            typingLines.clear();  // the whole line needs a new color
+        else if (typingLines.size() > 1)
+            relayoutLine = typingLines.size() - 2;
+
+        u32 relayoutStart = 0;
+
+        if (relayoutLine < typingLines.size())
+            relayoutStart = typingLines[relayoutLine].span.start;
+
+        vector<TextSpan> spans;
+        c.graphics->WrapText(spans, curTextUtf8.c_str() + relayoutStart, screenW);
+
+        if (spans.size() == 0)
+            spans.push_back({0, 0});
+
+        firstChanged = relayoutLine + spans.size();
+
+        for (u32 i = 0; i < spans.size(); ++i)
+        {
+            u32 index = relayoutLine + i;
+            TextSpan span = {relayoutStart + spans[i].start, spans[i].len};
+
+            if (index < typingLines.size() && typingLines[index].span.start == span.start &&
+                typingLines[index].span.len == span.len)
+                continue;  // cached line is still valid
 
-        if (type != Chat_Public)  // special case when they are sending a public message
-            col = chatColorMap.find(type)->second;
+            if (index >= typingLines.size())
+                typingLines.push_back(TypingLine());
 
-        curTextLines.clear();
-        c.graphics->MakeDrawnChat(curTextLines, Layer_Chat, col, screenW, nullptr,
-                                  curTextUtf8.c_str());
+            string text = curTextUtf8.substr(span.start, span.len);
+
+            if (text.length() == 0)
+                text = " ";
+
+            typingLines[index].span = span;
+            typingLines[index].drawn = c.graphics->MakeDrawnText(Layer_Chat, col, text.c_str());
+
+            if (index < firstChanged)
+                firstChanged = index;
+        }
+
+        typingLines.resize(relayoutLine + spans.size());
+    }
+
+    typingColor = col;
+
+    // everything only needs to move if the number of lines changed
+    if (typingLines.size() != oldLineCount)
+        UpdateChatLineVisuals();
+    else
+    {
+        for (u32 i = firstChanged; i < typingLines.size(); ++i)
+            UpdateTypingLineVisual(i);
     }
+}
 
-    UpdateChatLineVisuals();
+void ChatData::UpdateTypingLineVisual(u32 index)
+{
+    // typing lines are drawn at the very bottom, the last line is on the bottom row
+    i32 linesFromBottom = typingLines.size() - index;
+    shared_ptr<DrawnText> line = typingLines[index].drawn;
+
+    line->SetPosition(0, screenH - linesFromBottom * fontHeight);
+    line->SetVisible(escState == true || linesFromBottom <= displayLines);
 }
 
 void ChatData::UpdateChatLineVisuals()
@@ -271,16 +354,11 @@ void ChatData::UpdateChatLineVisuals()
     i32 offsetY = screenH;
     i32 displayed = 0;
 
-    for (auto line = curTextLines.rbegin(); line != curTextLines.rend(); ++line)
-    {
-        offsetY -= fontHeight;
-        (*line)->SetPosition(0, offsetY);
+    for (u32 i = 0; i < typingLines.size(); ++i)
+        UpdateTypingLineVisual(i);
 
-        if (escState == true || ++displayed <= displayLines)
-            (*line)->SetVisible(true);
-        else
-            (*line)->SetVisible(false);
-    }
+    offsetY -= fontHeight * typingLines.size();
+    displayed += typingLines.size();
 
     for (shared_ptr<DrawnText> line : chatBufferLines)
     {
@@ -154,8 +154,9 @@ class SegFaultHandler
     }
 };
 
-Client::Client()
+Client::Client(const vector<string>& cfgOverrides)
     :  // initialization order matters, add to the end
+      cfgOverrides(cfgOverrides),
       segFaultHandler(make_shared<SegFaultHandler>()),
       cfg(make_shared<Config>(*this)),
       log(make_shared<Logman>(*this)),
@@ -3,6 +3,7 @@
 #include <memory>
 #include <fstream>
 #include <stdlib.h>
+#include <stdarg.h>
 using namespace std;
 
 // the only thing that needs to be hardcoded
@@ -11,8 +12,84 @@ static const char* CONFIG_FILENAME = "config.ini";
 Config::Config(Client& c) : Module(c)
 {
     LoadSettings(CONFIG_FILENAME);
+
+    // overrides (from the command line, for example) replace values from the file
+    string category = "<none>";
+
+    for (const string& line : c.cfgOverrides)
+        ParseLine(line, &category);
+
+    ResolveValues();
+}
+
+// validators for ConfigSettings.h
+static bool AnyInt(i32 val)
+{
+    return true;
+}
+
+static bool IsPositive(i32 val)
+{
+    return val > 0;
+}
+
+static bool IsNonNegative(i32 val)
+{
+    return val >= 0;
+}
+
+static bool IsScreenDimension(i32 val)
+{
+    return val >= 100 && val <= 10000;
+}
+
+static bool IsFontSize(i32 val)
+{
+    return val >= 4 && val <= 128;
 }
 
+void Config::ResolveValues()
+{
+#define RESOLVE_INT(member, section, name, def, isAllowed) \
+    values.member = GetInt(section, name, def, isAllowed);
+#define RESOLVE_BOOL(member, section, name, def) \
+    values.member = GetInt(section, name, def ? 1 : 0) != 0;
+#define RESOLVE_STRING(member, section, name, def) values.member = GetString(section, name, def);
+#define RESOLVE_INT_LIST(member, section, name) values.member = GetIntList(section, name);
+
+    CONFIG_SETTINGS(RESOLVE_INT, RESOLVE_BOOL, RESOLVE_STRING, RESOLVE_INT_LIST)
+
+#undef RESOLVE_INT
+#undef RESOLVE_BOOL
+#undef RESOLVE_STRING
+#undef RESOLVE_INT_LIST
+}
+
+// logs, or saves the message for Logman if the log doesn't exist yet
+void Config::LogMessage(bool isError, const char* format, ...)
+{
+    char buf[512];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if (!c.log)
+        deferredMessages.push_back(make_pair(isError, string(buf)));
+    else if (isError)
+        c.log->LogError("%s", buf);
+    else
+        c.log->LogInfo("%s", buf);
+}
+
+void Config::TakeDeferredMessages(vector<pair<bool, string>>* store)
+{
+    store->insert(store->end(), deferredMessages.begin(), deferredMessages.end());
+    deferredMessages.clear();
+}
+
+
 static void trimLeadingWhitespace(string* s)
 {
     int eraseSpaces = 0;
@@ -193,87 +270,93 @@ void Config::LoadSettings(const char* path)
         {
             getline(fin, line);
 
-            trimComments(';', '\\', &line);
-            trimLeadingWhitespace(&line);
-            removeCr(&line);
+            ParseLine(line, &category);
+        }
+
+        fin.close();
+    }
+}
+
+// parse a single line of a config file, category is the current [section] (and gets updated)
+void Config::ParseLine(string line, string* category)
+{
+    trimComments(';', '\\', &line);
+    trimLeadingWhitespace(&line);
+    removeCr(&line);
+
+    if (line.length() > 0)
+    {  // if we have an actual line
+
+        trimTrailingWhitespace(&line);
+
+        // handle []'s
+        if (line[0] == '[')
+        {
+            line = line.substr(1);
+            trimComments(']', 0, &line);
+            trimWhitespace(&line);
+            toLower(&line);
+
+            *category = line;
+        }
+        else
+        {
+            // handle ::'s
+            string::size_type pos = line.find("::");
 
-            if (line.length() > 0)
-            {  // if we have an actual line
+            if (pos != string::npos)
+            {  // has a ::
+                string cat = line.substr(0, pos);
+                string sett = line.substr(pos + 2);
+                // now we need to split setting into setting=value
 
-                trimTrailingWhitespace(&line);
+                pos = sett.find("=");
 
-                // handle []'s
-                if (line[0] == '[')
+                if (pos != string::npos)
                 {
-                    line = line.substr(1);
-                    trimComments(']', 0, &line);
+                    string value = sett.substr(pos + 1);
+                    sett = sett.substr(0, pos);
+
+                    trimWhitespace(&cat);
+                    trimWhitespace(&sett);
+                    trimWhitespace(&value);
+
+                    toLower(&cat);
+                    toLower(&sett);
+
+                    settingsMap[cat][sett] = value;
+                }
+                else
+                {
+                    string err = "Line contains '::' but no '=', line = ";
+                    err += line;
+                    fprintf(stderr, "%s", err.c_str());
+                }
+            }
+            else
+            {  // handle regular setting=value
+                pos = line.find("=");
+
+                if (pos != string::npos)
+                {
+                    string value = line.substr(pos + 1);
+                    line = line.substr(0, pos);
+
                     trimWhitespace(&line);
+                    trimWhitespace(&value);
+
                     toLower(&line);
 
-                    category = line;
+                    settingsMap[*category][line] = value;
                 }
                 else
                 {
-                    // handle ::'s
-                    string::size_type pos = line.find("::");
-
-                    if (pos != string::npos)
-                    {  // has a ::
-                        string cat = line.substr(0, pos);
-                        string sett = line.substr(pos + 2);
-                        // now we need to split setting into setting=value
-
-                        pos = sett.find("=");
-
-                        if (pos != string::npos)
-                        {
-                            string value = sett.substr(pos + 1);
-                            sett = sett.substr(0, pos);
-
-                            trimWhitespace(&cat);
-                            trimWhitespace(&sett);
-                            trimWhitespace(&value);
-
-                            toLower(&cat);
-                            toLower(&sett);
-
-                            settingsMap[cat][sett] = value;
-                        }
-                        else
-                        {
-                            string err = "Line contains '::' but no '=', line = ";
-                            err += line;
-                            fprintf(stderr, "%s", err.c_str());
-                        }
-                    }
-                    else
-                    {  // handle regular setting=value
-                        pos = line.find("=");
-
-                        if (pos != string::npos)
-                        {
-                            string value = line.substr(pos + 1);
-                            line = line.substr(0, pos);
-
-                            trimWhitespace(&line);
-                            trimWhitespace(&value);
-
-                            toLower(&line);
-
-                            settingsMap[category][line] = value;
-                        }
-                        else
-                        {
-                            string err = "Line in config file does not contain '=', line = ";
-                            err += line;
-                            fprintf(stderr, "%s", err.c_str());
-                        }
-                    }
+                    string err = "Line in config file does not contain '=', line = ";
+                    err += line;
+                    fprintf(stderr, "%s", err.c_str());
                 }
             }
         }
-
-        fin.close();
     }
 }
 
@@ -282,8 +365,9 @@ const char* Config::GetString(const char* section, const char* name, const char*
     const char* rv = def;
     const char* val = GetStringNoDefault(section, name);
 
-    if (val == nullptr && c.log)
-        c.log->LogInfo("String setting %s::%s not found; defaulting to '%s'", section, name, def);
+    if (val == nullptr)
+        LogMessage(false, "String setting %s::%s not found; defaulting to '%s'", section, name,
+                   def);
     else
         rv = val;
 
@@ -297,8 +381,8 @@ const char* Config::GetString(const char* section, const char* name, const char*
 
     if (!IsAllowed(val))
     {
-        c.log->LogError("Invalid value for setting %s::%s='%s'. Using default of '%s'.", section,
-                        name, val, def);
+        LogMessage(true, "Invalid value for setting %s::%s='%s'. Using default of '%s'.",
+                   section, name, val, def);
         val = def;
     }
 
@@ -312,7 +396,7 @@ i32 Config::GetInt(const char* section, const char* name, i32 def)
 
     if (val == nullptr)
     {
-        c.log->LogInfo("Int setting %s::%s not found; defaulting to %d", section, name, def);
+        LogMessage(false, "Int setting %s::%s not found; defaulting to %d", section, name, def);
     }
     else
     {
@@ -322,8 +406,8 @@ i32 Config::GetInt(const char* section, const char* name, i32 def)
         if (*end == '\0')
             rv = i;
         else
-            c.log->LogError("Malformed int setting %s::%s='%s'; defaulting to %d", section, name,
-                            val, def);
+            LogMessage(true, "Malformed int setting %s::%s='%s'; defaulting to %d", section,
+                       name, val, def);
     }
 
     return rv;
@@ -335,8 +419,8 @@ i32 Config::GetInt(const char* section, const char* name, i32 def, bool (*IsAllo
 
     if (!IsAllowed(val))
     {
-        c.log->LogError("Invalid value for setting %s::%s=%i. Using default of %i.", section, name,
-                        val, def);
+        LogMessage(true, "Invalid value for setting %s::%s=%i. Using default of %i.", section,
+                   name, val, def);
         val = def;
     }
 
@@ -393,7 +477,7 @@ double Config::GetDouble(const char* section, const char* name, double def)
     const char* val = GetStringNoDefault(section, name);
 
     if (val == nullptr)
-        c.log->LogInfo("Double setting %s::%s not found; defaulting to %f", section, name, def);
+        LogMessage(false, "Double setting %s::%s not found; defaulting to %f", section, name, def);
     else
     {
         char* end;
@@ -402,8 +486,8 @@ double Config::GetDouble(const char* section, const char* name, double def)
         if (*end == '\0')
             rv = d;
         else
-            c.log->LogError("Malformed double setting %s::%s='%s'; defaulting to %f", section, name,
-                            val, def);
+            LogMessage(true, "Malformed double setting %s::%s='%s'; defaulting to %f", section,
+                       name, val, def);
     }
 
     return rv;
@@ -416,10 +500,24 @@ double Config::GetDouble(const char* section, const char* name, double def,
 
     if (!IsAllowed(val))
     {
-        c.log->LogError("Invalid value for setting %s::%s=%i. Using default of %f.", section, name,
-                        val, def);
+        LogMessage(true, "Invalid value for setting %s::%s=%f. Using default of %f.", section,
+                   name, val, def);
         val = def;
     }
 
     return val;
 }
+
+const map<string, string>* Config::GetSection(const char* sectionCstr)
+{
+    const map<string, string>* rv = nullptr;
+    string section = sectionCstr;
+    toLower(&section);
+
+    auto sec = settingsMap.find(section);
+
+    if (sec != settingsMap.end())
+        rv = &sec->second;
+
+    return rv;
+}
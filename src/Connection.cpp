@@ -83,15 +83,15 @@ struct ConnectionData
     string password;
     string connectAddr;
     ConnectionStatus state = STATUS_NOT_CONNECTED;
-    i32 protocolVersion = c.cfg->GetInt("Net", "Protocol Version", 0x1);
-    i32 encryptionKey = c.cfg->GetInt("Net", "Encryption Key", 0x1);
-    i32 clientVersion = c.cfg->GetInt("Net", "Client Version", 0x02);
+    i32 protocolVersion = c.cfg->Values().netProtocolVersion;
+    i32 encryptionKey = c.cfg->Values().netEncryptionKey;
+    i32 clientVersion = c.cfg->Values().netClientVersion;
 
     i32 numberEncryptionRequests = 0;
     i32 nextEncryptionRequestMs = 0;
 
-    i32 connectRetryMs = c.cfg->GetInt("Net", "Connection Retry Delay Mills", 1000);
-    i32 maxConnectionAttempts = c.cfg->GetInt("Net", "Max Connection Attempts", 10);
+    i32 connectRetryMs = c.cfg->Values().netConnectionRetryDelayMills;
+    i32 maxConnectionAttempts = c.cfg->Values().netMaxConnectionAttempts;
 
     string zoneDirName;   // set when Connection::Connect() is called
     string arenaDirName;  // set when Connection::SendArenaLogin() is called
@@ -340,9 +340,9 @@ struct ConnectionData
 
 Connection::Connection(Client& c) : Module(c), data(make_shared<ConnectionData>(c))
 {
-    data->username = c.cfg->GetString("connection", "username", "Player");
-    data->password = c.cfg->GetString("connection", "password", "1234");
-    data->connectAddr = c.cfg->GetString("connection", "connect_addr", "127.0.0.1:5000");
+    data->username = c.cfg->Values().connectionUsername;
+    data->password = c.cfg->Values().connectionPassword;
+    data->connectAddr = c.cfg->Values().connectionConnectAddr;
 
     c.chat->AddInternalCommand("disconnect", data->disconnectFunc);
     c.chat->AddInternalCommand("connect", data->connectFunc);
@@ -515,3 +515,14 @@ string Connection::GetZoneDir()
 
     return rv;
 }
+
+string Connection::GetMapStoreDir()
+{
+    // sanitized zone names never start with '.', so this can't collide with a zone dir
+    string rv = "zones/.map_store/";
+
+    data->MakeDir("zones");
+    data->MakeDir(rv.c_str());
+
+    return rv;
+}
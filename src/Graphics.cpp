@@ -2,29 +2,60 @@
 #include "SDLman.h"
 #include "Players.h"
 #include "Map.h"
+#include "Ships.h"
+#include "Trace.h"
 
 #include "SDL2/SDL_ttf.h"
 #include "utf8.h"
 #include <map>
 #include <unordered_set>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
 
 class ManagedTexture
 {
    public:
-    ManagedTexture(SDL_Texture* t) : rawTexture(t) {}
+    ManagedTexture(SDL_Texture* t) : rawTexture(t)
+    {
+        SDL_QueryTexture(t, NULL, NULL, &w, &h);
+    }
+
+    // headless mode, only the size is kept
+    ManagedTexture(i32 w, i32 h) : w(w), h(h) {}
+
     ~ManagedTexture()
     {
-        SDL_DestroyTexture(rawTexture);
+        if (rawTexture)
+            SDL_DestroyTexture(rawTexture);
+
         rawTexture = nullptr;
     }
 
     SDL_Texture* rawTexture = nullptr;
+    i32 w = 0, h = 0;
 };
 
 struct Image
 {
     Image(int numXFrames, int numYFrames, shared_ptr<ManagedTexture> tex, const char* filename);
 
+    // replace the texture, recomputing the frame sizes
+    void SetTexture(shared_ptr<ManagedTexture> tex);
+
+    // false while the image is still being loaded (the texture is an undrawn placeholder)
+    bool loaded = true;
+
     i32 numXFrames = 1;  // x frames in texture
     i32 numYFrames = 1;  // y frames in texture
 
@@ -58,7 +89,7 @@ class DrawnObject
     ~DrawnObject();
 
     void Draw(SDL_Renderer* renderer);
-    void Draw(SDL_Renderer* renderer, int xOffset, int yOffset);
+    void Draw(SDL_Renderer* renderer, int xOffset, int yOffset, float alpha);
     string ToString();
 
     Layer layer;
@@ -66,6 +97,8 @@ class DrawnObject
     shared_ptr<ManagedTexture> texture;
     SDL_Rect src = {0, 0, -1, 0};  // src.w = -1 means use nullptr
     SDL_Rect dest = {0, 0, 0, 0};
+    SDL_Rect prevDest = {0, 0, 0, 0};  // dest at the start of the simulation step
+    bool hasPrevDest = false;
     bool visible = true;
     const char* name = nullptr;
 
@@ -73,39 +106,113 @@ class DrawnObject
     shared_ptr<GraphicsData> gd;
 };
 
+// one-shot animations of the same Animation on the same layer, kept as parallel arrays (oldest
+// first) and drawn together; the frame comes from the time since each one started
+struct EffectBatch
+{
+    shared_ptr<Animation> anim;
+    Layer layer;
+    bool isMap;           // centers are in map pixels rather than screen pixels
+    vector<i32> centerX;
+    vector<i32> centerY;
+    vector<u32> startMs;  // GraphicsData::nowMs when it was made
+};
+
+// an image file found in the graphics folder
+struct ManifestEntry
+{
+    string path;
+    const char* type = nullptr;  // for IMG_LoadTyped_RW, null means detect it from the contents
+    i32 priority = 0;            // lower is preferred when names differ only by extension
+};
+
+// an image being decoded on a loader thread
+struct LoadJob
+{
+    shared_ptr<Image> image;
+    string filename;   // the file to load, or empty if it's in bytes
+    vector<u8> bytes;  // a copy of an image file in memory
+    SDL_Surface* surface = nullptr;  // set by the loader thread, null if loading failed
+};
+
 struct GraphicsData
 {
     GraphicsData(Client& client) : c(client) {}
     Client& c;
     string graphicsFolder;
 
+    // in headless mode there's no window, renderer or font; drawing only updates the counts
+    // text is measured with a fixed-width stand-in for the font
+    bool headless = false;
+    const i32 HEADLESS_GLYPH_WIDTH = 7;
+    const i32 HEADLESS_FONT_HEIGHT = 17;
+    u64 frameCount = 0;
+    u64 drawCount = 0;
+
     TTF_Font* font = nullptr;
     bool useBlendedFont = false;
 
     u32 windowW = 1, windowH = 1;
+    bool vsync = true;
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
 
     shared_ptr<ManagedTexture> notFoundTexture = nullptr;
 
+    // the graphics folder's images by filename, and by name without the extension; built once at
+    // startup and only read afterwards (so loader threads can use it without locking)
+    map<string, ManifestEntry> manifest;
+
+    // images by (filename, frames across, frames down), shared by everything that loads the same
+    // one and freed when the last user lets go (render thread only)
+    map<tuple<string, u32, u32>, weak_ptr<Image>> imageCache;
+
+    // images are decoded and converted to the texture format on loader threads, only creating the
+    // texture happens on the render thread (in FinishLoads(), at the start of each frame)
+    static const i32 LOADER_THREADS = 2;
+    vector<std::thread> loaderThreads;
+    std::mutex loadMutex;  // for stopLoaders and the two queues
+    std::condition_variable loadQueued;
+    bool stopLoaders = false;
+    deque<shared_ptr<LoadJob>> queuedLoads;
+    vector<shared_ptr<LoadJob>> finishedLoads;
+
+    // drawn images made while their image was still loading
+    unordered_set<DrawnImage*> placeholderImages;
+
     void LoadIcon();
+    void SizeText(const char* utf8, i32* w, i32* h);
+    void MakeHeadlessText(vector<shared_ptr<DrawnText>>& store, shared_ptr<GraphicsData> gd,
+                          Layer layer, u32 wrapPixels, const char* playerNameUtf8,
+                          const char* utf8, bool isMap);
+    void WrapText(vector<TextSpan>& store, const char* utf8, i32 wrapPixels, i32 firstLineExtra);
     void RenderWrappedSurface(vector<SDL_Surface*>& store, const char* playerName, const char* utf8,
                               SDL_Color textColor, i32 wrapPixels);
     SDL_Surface* RenderName(const char* playerNameUtf8, SDL_Color textColor, i32 maxLen);
-    SDL_Surface* LoadSurface(const string* path);
+    void BuildManifest();
+    SDL_Surface* LoadSurface(const char* filename);
+    SDL_Surface* PrepareSurface(SDL_Surface* surface, const char* name);
+    shared_ptr<Image> QueueLoad(shared_ptr<LoadJob> job, u32 framesW, u32 framesH,
+                                const char* name);
+    void LoaderLoop();
+    void FinishLoads();
+    void StopLoaders();
     SDL_Surface* MakeMemorySurface(i32 w, i32 h);  // won't return nul
     SDL_Texture* SurfaceToTexture(SDL_Surface* s);
     shared_ptr<ManagedTexture> LoadTexture(const char* filename);
+    shared_ptr<ManagedTexture> SurfaceToManagedTexture(SDL_Surface* surface, const char* name);
     void MakeDrawnText(vector<shared_ptr<DrawnText>>& store, shared_ptr<GraphicsData> gd,
                        Layer layer, TextColor color, u32 wrapPixels, const char* playerNameUtf8,
                        const char* utf8, bool isMap);
     void MakeWrappedTextSurfaces(vector<SDL_Surface*>& surfStore, vector<string>& lines,
                                  SDL_Surface* nameSurface, SDL_Color textColor, i32 wrapPixels);
     void DrawImageFrame(shared_ptr<Image> i, i32 frame, i32 pixelX, i32 pixelY);
+    void ExpireEffects();
+    void DrawEffects(const EffectBatch& b, i32 mapOffsetX, i32 mapOffsetY);
 
     u32 nowMs = 0;  // for tracking single animation expiration time
     multimap<Layer, DrawnObject*> drawnObjs;
-    multimap<u32, shared_ptr<DrawnImage>> singleAnimations;  // expirationMs -> DrawnImage
+    vector<EffectBatch> effects;  // sorted by layer, batches are kept when they empty out
     unordered_set<DrawnImage*> animations;
 
     map<TextColor, SDL_Color> colorMap = {
@@ -139,15 +246,138 @@ void GraphicsData::DrawImageFrame(shared_ptr<Image> i, i32 frame, i32 pixelX, i3
         SDL_Rect src = {offsetX, offsetY, i->frameWidth, i->frameHeight};
         SDL_Rect dest = {pixelX, pixelY, i->frameWidth, i->frameHeight};
 
+        ++drawCount;
+
+        if (!headless && i->loaded)
+            SDL_RenderCopy(renderer, i->texture->rawTexture, &src, &dest);
+    }
+}
+
+// drop finished effects, compacting the arrays in place (keeps the order, so the oldest are
+// still drawn first)
+void GraphicsData::ExpireEffects()
+{
+    for (EffectBatch& b : effects)
+    {
+        u32 kept = 0;
+
+        for (u32 i = 0; i < b.startMs.size(); ++i)
+        {
+            if (nowMs - b.startMs[i] < b.anim->animMs)
+            {
+                b.centerX[kept] = b.centerX[i];
+                b.centerY[kept] = b.centerY[i];
+                b.startMs[kept] = b.startMs[i];
+                ++kept;
+            }
+        }
+
+        b.centerX.resize(kept);
+        b.centerY.resize(kept);
+        b.startMs.resize(kept);
+    }
+}
+
+// consecutive copies from one texture, which SDL's renderer batches into a single draw
+// the offsets take map pixels to screen pixels, for map batches
+void GraphicsData::DrawEffects(const EffectBatch& b, i32 mapOffsetX, i32 mapOffsetY)
+{
+    const Animation* a = b.anim.get();
+    const Image* i = a->image.get();
+    u32 count = b.startMs.size();
+    i32 offsetX = b.isMap ? mapOffsetX : 0;
+    i32 offsetY = b.isMap ? mapOffsetY : 0;
+
+    drawCount += count;
+
+    if (headless || !i->loaded)
+        return;
+
+    for (u32 n = 0; n < count; ++n)
+    {
+        u32 frame = a->animFrameOffset + (nowMs - b.startMs[n]) * a->animNumFrames / a->animMs;
+        i32 xFrame = frame % i->numXFrames;
+        i32 yFrame = (frame / i->numXFrames) % i->numYFrames;
+
+        SDL_Rect src = {xFrame * i->frameWidth, yFrame * i->frameHeight, i->frameWidth,
+                        i->frameHeight};
+        SDL_Rect dest = {b.centerX[n] + offsetX - i->halfFrameWidth,
+                         b.centerY[n] + offsetY - i->halfFrameHeight, i->frameWidth,
+                         i->frameHeight};
+
         SDL_RenderCopy(renderer, i->texture->rawTexture, &src, &dest);
     }
 }
 
+void GraphicsData::SizeText(const char* utf8, i32* w, i32* h)
+{
+    if (headless)
+    {
+        const char* end = utf8 + strlen(utf8);
+
+        *w = HEADLESS_GLYPH_WIDTH * utf8::distance(utf8, utf8::find_invalid(utf8, end));
+        *h = HEADLESS_FONT_HEIGHT;
+    }
+    else if (TTF_SizeUTF8(font, utf8, w, h))
+        c.log->FatalError("TTF_SizeUTF8 Failed: '%s'", TTF_GetError());
+}
+
+// the same lines as MakeDrawnText, but with textureless objects sized by SizeText()
+void GraphicsData::MakeHeadlessText(vector<shared_ptr<DrawnText>>& store,
+                                    shared_ptr<GraphicsData> data, Layer layer, u32 wrapPixels,
+                                    const char* playerNameUtf8, const char* utf8, bool isMap)
+{
+    vector<TextSpan> spans;
+    i32 nameWidth = 0;
+
+    if (playerNameUtf8 != nullptr)
+    {
+        i32 h = 0;
+        string name = string(playerNameUtf8) + ">  ";
+
+        SizeText(name.c_str(), &nameWidth, &h);
+        nameWidth = min(nameWidth, (i32)wrapPixels / 4);
+    }
+
+    if (wrapPixels == 0)
+        spans.push_back({0, (u32)strlen(utf8)});
+    else
+        WrapText(spans, utf8, wrapPixels, nameWidth);
+
+    if (spans.size() == 0)
+        spans.push_back({0, 0});
+
+    for (u32 i = 0; i < spans.size(); ++i)
+    {
+        string line(utf8 + spans[i].start, spans[i].len);
+        i32 w = 0, h = 0;
+
+        SizeText(line.c_str(), &w, &h);
+
+        if (i == 0)
+            w += nameWidth;
+
+        shared_ptr<ManagedTexture> mt = make_shared<ManagedTexture>(w, h);
+        shared_ptr<DrawnObject> drawn = make_shared<DrawnObject>(data, layer, mt, isMap, "text");
+
+        drawn->dest.w = w;
+        drawn->dest.h = h;
+
+        store.push_back(make_shared<DrawnText>(drawn));
+    }
+}
+
 void GraphicsData::MakeDrawnText(vector<shared_ptr<DrawnText>>& store,
                                  shared_ptr<GraphicsData> data, Layer layer, TextColor color,
                                  u32 wrapPixels, const char* playerNameUtf8, const char* utf8,
                                  bool isMap = false)
 {
+    if (headless)
+    {
+        MakeHeadlessText(store, data, layer, wrapPixels, playerNameUtf8, utf8, isMap);
+        return;
+    }
+
     SDL_Color textColor = colorMap.find(color)->second;
 
     vector<SDL_Surface*> surfStore;
@@ -179,7 +409,8 @@ void GraphicsData::MakeDrawnText(vector<shared_ptr<DrawnText>>& store,
         shared_ptr<ManagedTexture> mt = make_shared<ManagedTexture>(tex);
         shared_ptr<DrawnObject> drawn = make_shared<DrawnObject>(data, layer, mt, isMap, "text");
 
-        SDL_QueryTexture(tex, NULL, NULL, &drawn->dest.w, &drawn->dest.h);
+        drawn->dest.w = mt->w;
+        drawn->dest.h = mt->h;
 
         store.push_back(make_shared<DrawnText>(drawn));
     }
@@ -275,80 +506,75 @@ SDL_Surface* GraphicsData::RenderName(const char* playerNameUtf8, SDL_Color text
     return nameSurface;
 }
 
-// returns a valid SDL_Surface
-void GraphicsData::RenderWrappedSurface(vector<SDL_Surface*>& surfStore, const char* playerNameUtf8,
-                                        const char* textUtf8, SDL_Color textColor, i32 wrapPixels)
+// break utf8 into lines no wider than wrapPixels, preferring to break on spaces
+// the first line can be shortened by firstLineExtra pixels (used for the player name)
+void GraphicsData::WrapText(vector<TextSpan>& store, const char* textUtf8, i32 wrapPixels,
+                            i32 firstLineExtra)
 {
-    SDL_Surface* nameSurface = RenderName(playerNameUtf8, textColor, wrapPixels / 4);
-
     string utf8 = textUtf8;
-
-    vector<string> lines;
-    string curLine;
+    u32 lineStart = 0;
 
     auto it = utf8.begin();
     auto end = utf8::find_invalid(utf8.begin(), utf8.end());
 
     while (it != end)
     {
-        u32 codePoint = utf8::next(it, end);
-
-        // add a single codePoint to curText, if there's space
-        unsigned char u[5] = {0, 0, 0, 0, 0};
-        unsigned char* end = utf8::append(codePoint, u);
-        u32 len = end - u;
+        u32 codePointStart = it - utf8.begin();
+        utf8::next(it, end);
+        u32 codePointEnd = it - utf8.begin();
 
-        for (u32 i = 0; i < len; ++i)
-            curLine += u[i];
-
-        // check if length of curline goes over wrappixels
+        // check if length of the current line goes over wrappixels
+        string curLine = utf8.substr(lineStart, codePointEnd - lineStart);
         i32 w = 0, h = 0;
 
-        if (TTF_SizeUTF8(font, curLine.c_str(), &w, &h))
-            c.log->FatalError("TTF_SizeUTF8 Failed: '%s'", TTF_GetError());
+        SizeText(curLine.c_str(), &w, &h);
 
         // on the first line, include extra width for the name
-        i32 extraWidth = (lines.size() == 0 && nameSurface != nullptr) ? nameSurface->w : 0;
+        i32 extraWidth = store.size() == 0 ? firstLineExtra : 0;
 
         if (w + extraWidth > wrapPixels)
         {
-            // pop last characters off until a space is encountered, and start a new line
-            string::iterator spacePos = curLine.end();
-
-            while (spacePos != curLine.begin())
-            {
-                u32 codePoint = utf8::prior(spacePos, curLine.begin());
+            // look backwards for a space to break on (a space never occurs inside a multi-byte
+            // utf8 sequence, so a byte search is safe)
+            u32 spacePos = codePointEnd;
 
-                if (codePoint == (u32)' ')
-                    break;
-            }
+            while (spacePos > lineStart && utf8[spacePos - 1] != ' ')
+                --spacePos;
 
-            if (spacePos == curLine.begin())
+            if (spacePos <= lineStart + 1)
             {
-                // no space was found in curLine, force a break
-                for (u32 i = 0; i < len; ++i)
-                    curLine.pop_back();
-
-                lines.push_back(curLine);
-                curLine = "";
-
-                for (u32 i = 0; i < len; ++i)
-                    curLine += u[i];
+                // no space was found in the line, force a break before the last code point
+                store.push_back({lineStart, codePointStart - lineStart});
+                lineStart = codePointStart;
             }
             else
             {
-                // a space was found, copy everything after the space to the next line
-                string nextLine = string(spacePos + 1, curLine.end());
-                curLine = string(curLine.begin(), spacePos);
-
-                lines.push_back(curLine);
-                curLine = nextLine;
+                // a space was found, everything after the space goes to the next line
+                store.push_back({lineStart, spacePos - 1 - lineStart});
+                lineStart = spacePos;
             }
         }
     }
 
-    if (curLine.length() > 0)
-        lines.push_back(curLine);
+    u32 textEnd = end - utf8.begin();
+
+    if (textEnd > lineStart)
+        store.push_back({lineStart, textEnd - lineStart});
+}
+
+// returns a valid SDL_Surface
+void GraphicsData::RenderWrappedSurface(vector<SDL_Surface*>& surfStore, const char* playerNameUtf8,
+                                        const char* textUtf8, SDL_Color textColor, i32 wrapPixels)
+{
+    SDL_Surface* nameSurface = RenderName(playerNameUtf8, textColor, wrapPixels / 4);
+
+    vector<TextSpan> spans;
+    WrapText(spans, textUtf8, wrapPixels, nameSurface != nullptr ? nameSurface->w : 0);
+
+    vector<string> lines;
+
+    for (const TextSpan& span : spans)
+        lines.push_back(string(textUtf8 + span.start, span.len));
 
     // at this point, lines contains the string to render for each line
     MakeWrappedTextSurfaces(surfStore, lines, nameSurface, textColor, wrapPixels);
@@ -421,63 +647,336 @@ void GraphicsData::MakeWrappedTextSurfaces(vector<SDL_Surface*>& surfStore, vect
         SDL_FreeSurface(nameSurface);
 }
 
-// may return null
-SDL_Surface* GraphicsData::LoadSurface(const string* path)
+struct ImageFormat
 {
-    SDL_Surface* surface = nullptr;
+    const char* ext;
+    const char* type;
+};
+
+// in the order they're preferred when files differ only by extension
+static const ImageFormat IMAGE_FORMATS[] = {
+    {".png", "PNG"}, {".bmp", "BMP"}, {".bm2", "BMP"}, {".jpg", "JPG"}, {".gif", "GIF"},
+    {".tif", "TIF"}, {".jpeg", "JPG"}, {".tiff", "TIF"}, {".pnm", "PNM"}, {".ppm", "PNM"},
+    {".pgm", "PNM"}, {".pbm", "PNM"}, {".xpm", "XPM"}, {".lbm", "LBM"}, {".pcx", "PCX"},
+    {".tga", "TGA"}, {"", nullptr}};
+
+// list the graphics folder once, rather than probing extensions for every load
+void GraphicsData::BuildManifest()
+{
+    vector<string> files;
+    bool listed = false;
 
-    if (strchr(path->c_str(), '.') != nullptr)
+#ifdef WIN32
+    struct _finddata_t found;
+    string pattern = graphicsFolder + "/*";
+    intptr_t handle = _findfirst(pattern.c_str(), &found);
+
+    if (handle != -1)
     {
-        surface = IMG_Load(path->c_str());
+        listed = true;
 
-        if (!surface)
-            c.log->LogError("Error loading image '%s': %s", path->c_str(), IMG_GetError());
+        do
+        {
+            if ((found.attrib & _A_SUBDIR) == 0)
+                files.push_back(found.name);
+        } while (_findnext(handle, &found) == 0);
+
+        _findclose(handle);
     }
-    else
+#else
+    DIR* dir = opendir(graphicsFolder.c_str());
+
+    if (dir != nullptr)
+    {
+        listed = true;
+
+        for (struct dirent* ent = readdir(dir); ent != nullptr; ent = readdir(dir))
+        {
+            if (ent->d_name[0] == '.')
+                continue;
+
+            // subfolders aren't images, some filesystems don't fill in d_type
+            bool isDir = ent->d_type == DT_DIR;
+
+            if (ent->d_type == DT_UNKNOWN)
+            {
+                struct stat st;
+                string path = graphicsFolder + "/" + ent->d_name;
+
+                isDir = stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+            }
+
+            if (!isDir)
+                files.push_back(ent->d_name);
+        }
+
+        closedir(dir);
+    }
+#endif
+
+    if (!listed)
+        c.log->LogError("Error listing the graphics folder '%s'", graphicsFolder.c_str());
+
+    i32 numImages = 0;
+
+    for (const string& file : files)
     {
-        // try a bunch of image extensions
-        const char* exts[] = {".png",  ".bmp",  ".bm2", ".jpg", ".gif", ".tif",
-                              ".jpeg", ".tiff", ".pnm", ".ppm", ".pgm", ".pbm",
-                              ".xpm",  ".lbm",  ".pcx", ".tga", ""};
+        size_t dot = file.rfind('.');
+        string name = file.substr(0, dot);
+        string ext = dot == string::npos ? "" : file.substr(dot);
+
+        for (char& ch : ext)
+            ch = tolower(ch);
 
-        for (const char* ext : exts)
+        for (i32 i = 0; i < (i32)(sizeof(IMAGE_FORMATS) / sizeof(IMAGE_FORMATS[0])); ++i)
         {
-            string tryPath = *path + ext;
+            if (ext == IMAGE_FORMATS[i].ext)
+            {
+                ManifestEntry e;
+                e.path = graphicsFolder + "/" + file;
+                e.type = IMAGE_FORMATS[i].type;
+                e.priority = i;
+
+                manifest[file] = e;
+
+                auto it = manifest.find(name);
 
-            surface = IMG_Load(tryPath.c_str());
+                if (it == manifest.end() || it->second.priority > i)
+                    manifest[name] = e;
 
-            if (surface)
+                ++numImages;
                 break;
+            }
         }
     }
 
+    c.log->LogDrivel("Found %d images in '%s'", numImages, graphicsFolder.c_str());
+}
+
+// filename is relative to the graphics folder, with or without an extension; may return null
+SDL_Surface* GraphicsData::LoadSurface(const char* filename)
+{
+    SDL_Surface* surface = nullptr;
+    auto it = manifest.find(filename);
+
+    if (it != manifest.end())
+    {
+        const ManifestEntry& e = it->second;
+
+        surface = IMG_LoadTyped_RW(SDL_RWFromFile(e.path.c_str(), "rb"), 1, e.type);
+
+        if (!surface)
+            c.log->LogError("Error loading image '%s': %s", e.path.c_str(), IMG_GetError());
+    }
+    else if (strchr(filename, '.') != nullptr)
+    {
+        // not directly in the folder (it could be in a subfolder)
+        string path = graphicsFolder + "/" + filename;
+
+        surface = IMG_Load(path.c_str());
+
+        if (!surface)
+            c.log->LogError("Error loading image '%s': %s", path.c_str(), IMG_GetError());
+    }
+    else
+        c.log->LogError("No image named '%s' in '%s'", filename, graphicsFolder.c_str());
+
     return surface;
 }
 
 shared_ptr<ManagedTexture> GraphicsData::LoadTexture(const char* filename)
 {
-    string path = graphicsFolder + "/" + filename;
-
-    SDL_Surface* surface = LoadSurface(&path);
+    SDL_Surface* surface = LoadSurface(filename);
     shared_ptr<ManagedTexture> rv = nullptr;
 
     if (surface)
     {
         c.log->LogDrivel("Loaded image from '%s'", filename);
 
-        if (SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, 0, 0, 0)))
-            c.log->LogError("SDL_SetColorKey failed on '%s': %s", filename, SDL_GetError());
+        rv = SurfaceToManagedTexture(surface, filename);
+    }
+    else
+        rv = notFoundTexture;
 
-        SDL_Texture* rawTexture = SurfaceToTexture(surface);
-        rv = make_shared<ManagedTexture>(rawTexture);
+    return rv;
+}
+
+// on a loader thread: color key black and convert to the usual texture format, so that
+// SDL_CreateTextureFromSurface on the render thread is just an upload; takes ownership of surface
+SDL_Surface* GraphicsData::PrepareSurface(SDL_Surface* surface, const char* name)
+{
+    if (SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, 0, 0, 0)))
+        c.log->LogError("SDL_SetColorKey failed on '%s': %s", name, SDL_GetError());
+
+    SDL_Surface* rv = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+
+    if (rv == nullptr)
+    {
+        c.log->LogError("SDL_ConvertSurfaceFormat failed on '%s': %s", name, SDL_GetError());
+        rv = surface;  // SDL_CreateTextureFromSurface will convert it
     }
     else
+        SDL_FreeSurface(surface);
+
+    return rv;
+}
+
+// returns a placeholder image (nothing is drawn for it) which FinishLoads() fills in once the job
+// is done
+shared_ptr<Image> GraphicsData::QueueLoad(shared_ptr<LoadJob> job, u32 framesW, u32 framesH,
+                                          const char* name)
+{
+    // frames of the placeholder are 1x1, so anything sized from them stays small
+    shared_ptr<ManagedTexture> placeholder = make_shared<ManagedTexture>(framesW, framesH);
+
+    job->image = make_shared<Image>(framesW, framesH, placeholder, name);
+    job->image->loaded = false;
+
     {
-        if (strchr(path.c_str(), '.') == nullptr)
-            path += ".png";  // for the error message
+        std::lock_guard<std::mutex> lock(loadMutex);
 
-        c.log->LogError("Error loading image at path '%s'", path.c_str());
-        rv = notFoundTexture;
+        if (loaderThreads.empty())
+        {
+            for (i32 i = 0; i < LOADER_THREADS; ++i)
+                loaderThreads.push_back(std::thread([this]() { LoaderLoop(); }));
+        }
+
+        queuedLoads.push_back(job);
+    }
+
+    loadQueued.notify_one();
+
+    return job->image;
+}
+
+void GraphicsData::LoaderLoop()
+{
+    std::unique_lock<std::mutex> lock(loadMutex);
+
+    while (true)
+    {
+        loadQueued.wait(lock, [this]() { return stopLoaders || !queuedLoads.empty(); });
+
+        if (stopLoaders)
+            break;
+
+        shared_ptr<LoadJob> job = queuedLoads.front();
+        queuedLoads.pop_front();
+        lock.unlock();
+
+        const char* name = job->image->filename.c_str();
+        SDL_Surface* surface = nullptr;
+
+        if (job->filename.empty())
+        {
+            surface = IMG_Load_RW(SDL_RWFromConstMem(job->bytes.data(), job->bytes.size()), 1);
+
+            if (!surface)
+                c.log->LogError("Error loading image '%s' from memory: %s", name, IMG_GetError());
+        }
+        else
+            surface = LoadSurface(job->filename.c_str());
+
+        if (surface)
+            job->surface = PrepareSurface(surface, name);
+
+        lock.lock();
+        finishedLoads.push_back(job);
+    }
+}
+
+// on the render thread, turn finished loads into textures and swap them into their images
+void GraphicsData::FinishLoads()
+{
+    vector<shared_ptr<LoadJob>> jobs;
+
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        jobs.swap(finishedLoads);
+    }
+
+    for (shared_ptr<LoadJob>& job : jobs)
+    {
+        shared_ptr<ManagedTexture> tex = nullptr;
+        const char* name = job->image->filename.c_str();
+
+        if (job->surface == nullptr)
+        {
+            c.log->LogError("Error loading image '%s'", name);
+            tex = notFoundTexture;
+        }
+        else if (headless)
+        {
+            tex = make_shared<ManagedTexture>(job->surface->w, job->surface->h);
+            SDL_FreeSurface(job->surface);
+        }
+        else
+        {
+            c.log->LogDrivel("Loaded image '%s'", name);
+            tex = make_shared<ManagedTexture>(SurfaceToTexture(job->surface));
+        }
+
+        job->surface = nullptr;
+        job->image->SetTexture(tex);
+        job->image->loaded = true;
+
+        for (auto it = placeholderImages.begin(); it != placeholderImages.end();)
+        {
+            if ((*it)->HasImage(job->image))
+            {
+                (*it)->RefreshImage();
+                it = placeholderImages.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+}
+
+void GraphicsData::StopLoaders()
+{
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        stopLoaders = true;
+    }
+
+    loadQueued.notify_all();
+
+    for (std::thread& t : loaderThreads)
+        t.join();
+
+    loaderThreads.clear();
+
+    // anything decoded but never turned into a texture
+    for (shared_ptr<LoadJob>& job : finishedLoads)
+    {
+        if (job->surface)
+            SDL_FreeSurface(job->surface);
+    }
+
+    finishedLoads.clear();
+    queuedLoads.clear();
+}
+
+// takes ownership of the surface
+shared_ptr<ManagedTexture> GraphicsData::SurfaceToManagedTexture(SDL_Surface* surface,
+                                                                 const char* name)
+{
+    shared_ptr<ManagedTexture> rv = nullptr;
+
+    if (headless)
+    {
+        // only the size is needed
+        rv = make_shared<ManagedTexture>(surface->w, surface->h);
+        SDL_FreeSurface(surface);
+    }
+    else
+    {
+        if (SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, 0, 0, 0)))
+            c.log->LogError("SDL_SetColorKey failed on '%s': %s", name, SDL_GetError());
+
+        SDL_Texture* rawTexture = SurfaceToTexture(surface);
+        rv = make_shared<ManagedTexture>(rawTexture);
     }
 
     return rv;
@@ -499,10 +998,9 @@ SDL_Texture* GraphicsData::SurfaceToTexture(SDL_Surface* s)
 void GraphicsData::LoadIcon()
 {
     // load icon
-    string iconName =
-        graphicsFolder + "/" + c.cfg->GetString("graphics", "icon_image_name", "icon");
+    const string& iconName = c.cfg->Values().graphicsIconImageName;
 
-    SDL_Surface* icon = LoadSurface(&iconName);
+    SDL_Surface* icon = LoadSurface(iconName.c_str());
 
     if (icon)
     {
@@ -520,6 +1018,11 @@ void DrawnObject::Draw(SDL_Renderer* r)
 {
     if (visible)
     {
+        ++gd->drawCount;
+
+        if (gd->headless || texture->rawTexture == nullptr)
+            return;
+
         if (src.w == -1)
             SDL_RenderCopy(r, texture->rawTexture, nullptr, &dest);
         else
@@ -527,14 +1030,26 @@ void DrawnObject::Draw(SDL_Renderer* r)
     }
 }
 
-void DrawnObject::Draw(SDL_Renderer* r, int xOffset, int yOffset)
+void DrawnObject::Draw(SDL_Renderer* r, int xOffset, int yOffset, float alpha)
 {
     if (visible)
     {
         SDL_Rect offsetDest = dest;
+
+        if (hasPrevDest)
+        {
+            offsetDest.x = prevDest.x + (dest.x - prevDest.x) * alpha;
+            offsetDest.y = prevDest.y + (dest.y - prevDest.y) * alpha;
+        }
+
         offsetDest.x += xOffset;
         offsetDest.y += yOffset;
 
+        ++gd->drawCount;
+
+        if (gd->headless || texture->rawTexture == nullptr)
+            return;
+
         if (src.w == -1)
             SDL_RenderCopy(r, texture->rawTexture, nullptr, &offsetDest);
         else
@@ -616,12 +1131,36 @@ DrawnImage::DrawnImage(shared_ptr<GraphicsData> gd, Layer layer, u32 animMs, u32
     // if it's an animation, add it to the animation list
     if (animMs > 0)
         gd->animations.insert(this);
+
+    // resized once the real image is loaded
+    if (!image->loaded)
+        gd->placeholderImages.insert(this);
 }
 
 DrawnImage::~DrawnImage()
 {
     if (animMs > 0)
         gd->animations.erase(this);
+
+    gd->placeholderImages.erase(this);
+}
+
+bool DrawnImage::HasImage(shared_ptr<Image> i)
+{
+    return image == i;
+}
+
+// the image finished loading, redo everything that was sized from the placeholder
+void DrawnImage::RefreshImage()
+{
+    drawnObj->texture = image->texture;
+    drawnObj->dest.w = drawnObj->src.w = image->frameWidth;
+    drawnObj->dest.h = drawnObj->src.h = image->frameHeight;
+
+    UpdateFrameSource();
+
+    if (hasCenter)
+        SetCenterPosition(centerX, centerY);
 }
 
 void DrawnImage::AdvanceAnimation(u32 mills)
@@ -642,19 +1181,24 @@ void DrawnImage::SetFrame(u32 frameNum)
     {
         lastFrameNum = frameNum;
 
-        i32 x = frameNum % image->numXFrames;  // to get col #, we modulo the width
-        i32 y = frameNum / image->numXFrames;  // to get the row #, we divide by width
+        UpdateFrameSource();
+    }
+}
 
-        if (y >= image->numYFrames)
-        {
-            y = 0;
-            gd->c.log->LogError("Frame (%i) was out of bounds for %dx%d image '%s'", frameNum,
-                                image->numXFrames, image->numYFrames, image->filename.c_str());
-        }
+void DrawnImage::UpdateFrameSource()
+{
+    i32 x = lastFrameNum % image->numXFrames;  // to get col #, we modulo the width
+    i32 y = lastFrameNum / image->numXFrames;  // to get the row #, we divide by width
 
-        drawnObj->src.x = x * image->frameWidth;
-        drawnObj->src.y = y * image->frameHeight;
+    if (y >= image->numYFrames)
+    {
+        y = 0;
+        gd->c.log->LogError("Frame (%i) was out of bounds for %dx%d image '%s'", lastFrameNum,
+                            image->numXFrames, image->numYFrames, image->filename.c_str());
     }
+
+    drawnObj->src.x = x * image->frameWidth;
+    drawnObj->src.y = y * image->frameHeight;
 }
 
 u32 DrawnImage::GetFrame()
@@ -669,6 +1213,10 @@ const char* DrawnImage::GetName()
 
 void DrawnImage::SetCenterPosition(i32 x, i32 y)
 {
+    hasCenter = true;
+    centerX = x;
+    centerY = y;
+
     drawnObj->dest.x = x - image->halfFrameHeight;
     drawnObj->dest.y = y - image->halfFrameWidth;
 }
@@ -679,9 +1227,16 @@ void DrawnImage::SetVisible(bool vis)
 }
 
 Image::Image(int numXFrames, int numYFrames, shared_ptr<ManagedTexture> tex, const char* filename)
-    : numXFrames(numXFrames), numYFrames(numYFrames), texture(tex), filename(filename)
+    : numXFrames(numXFrames), numYFrames(numYFrames), filename(filename)
 {
-    SDL_QueryTexture(tex->rawTexture, NULL, NULL, &textureWidth, &textureHeight);
+    SetTexture(tex);
+}
+
+void Image::SetTexture(shared_ptr<ManagedTexture> tex)
+{
+    texture = tex;
+    textureWidth = tex->w;
+    textureHeight = tex->h;
 
     frameWidth = textureWidth / numXFrames;
     frameHeight = textureHeight / numYFrames;
@@ -696,19 +1251,30 @@ Animation::Animation(shared_ptr<Image> i, u32 animMs, u32 animFrameOffset, u32 a
 
 Graphics::Graphics(Client& c) : Module(c), data(make_shared<GraphicsData>(c))
 {
-    data->graphicsFolder = c.cfg->GetString("Graphics", "folder", "resources");
+    data->graphicsFolder = c.cfg->Values().graphicsFolder;
+    data->windowW = c.cfg->Values().videoWidth;
+    data->windowH = c.cfg->Values().videoHeight;
+    data->headless = c.cfg->Values().videoHeadless;
+
+    data->BuildManifest();
+
+    if (data->headless)
+    {
+        // no window, renderer or font; images are still loaded to get their sizes
+        c.log->LogDrivel("Running headless: %ix%i", data->windowW, data->windowH);
+        data->vsync = false;
+
+        data->notFoundTexture =
+            data->LoadTexture(c.cfg->Values().graphicsNotFoundImageName.c_str());
+
+        if (data->notFoundTexture == nullptr)
+            data->notFoundTexture = make_shared<ManagedTexture>(1, 1);
 
-    data->windowW = c.cfg->GetInt("video", "width", 800, [](i32 val)
-                                  {
-                                      return val >= 100 && val <= 10000;
-                                  });
-    data->windowH = c.cfg->GetInt("video", "height", 600, [](i32 val)
-                                  {
-                                      return val >= 100 && val <= 10000;
-                                  });
+        return;
+    }
 
     c.log->LogDrivel("Creating window: %ix%i", data->windowW, data->windowH);
-    const char* title = c.cfg->GetString("video", "title", "Discretion2");
+    const char* title = c.cfg->Values().videoTitle.c_str();
 
     data->window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
                                     data->windowW, data->windowH, 0);
@@ -718,8 +1284,13 @@ Graphics::Graphics(Client& c) : Module(c), data(make_shared<GraphicsData>(c))
 
     data->LoadIcon();
 
-    data->renderer =
-        SDL_CreateRenderer(data->window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    data->vsync = c.cfg->Values().videoVsync;
+    Uint32 rendererFlags = SDL_RENDERER_ACCELERATED;
+
+    if (data->vsync)
+        rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+
+    data->renderer = SDL_CreateRenderer(data->window, -1, rendererFlags);
 
     if (data->renderer == nullptr)
         c.log->FatalError("Failed to create renderer: %s", SDL_GetError());
@@ -730,8 +1301,7 @@ Graphics::Graphics(Client& c) : Module(c), data(make_shared<GraphicsData>(c))
     // Set color of renderer to black
     SDL_SetRenderDrawColor(data->renderer, 0, 0, 0, 255);
 
-    const char* notFoundFilename =
-        c.cfg->GetString("graphics", "not_found_image_name", "not_found");
+    const char* notFoundFilename = c.cfg->Values().graphicsNotFoundImageName.c_str();
     data->notFoundTexture = data->LoadTexture(notFoundFilename);
 
     if (data->notFoundTexture == nullptr)
@@ -748,13 +1318,8 @@ Graphics::Graphics(Client& c) : Module(c), data(make_shared<GraphicsData>(c))
                      compVer.minor, compVer.patch);
 
     // load font
-    string fontPath =
-        data->graphicsFolder + "/" + c.cfg->GetString("text", "font_file", "source_han_sans.otf");
-
-    i32 size = c.cfg->GetInt("text", "font_size", 12, [](i32 val)
-                             {
-                                 return val >= 4 && val <= 128;
-                             });
+    string fontPath = data->graphicsFolder + "/" + c.cfg->Values().textFontFile;
+    i32 size = c.cfg->Values().textFontSize;
 
     data->font = TTF_OpenFont(fontPath.c_str(), size);
 
@@ -766,13 +1331,15 @@ Graphics::Graphics(Client& c) : Module(c), data(make_shared<GraphicsData>(c))
     else
         c.log->LogDrivel("Loaded font from '%s'", fontPath.c_str());
 
-    data->useBlendedFont = c.cfg->GetInt("text", "use_blended_font", 1) != 0;
+    data->useBlendedFont = c.cfg->Values().textUseBlendedFont;
 }
 
 Graphics::~Graphics()
 {
+    data->StopLoaders();
+
     // remove all managed animations
-    data->singleAnimations.clear();
+    data->effects.clear();
 
     // animations should now be empty
     for (auto it : data->animations)
@@ -782,11 +1349,14 @@ Graphics::~Graphics()
     for (auto it2 : data->drawnObjs)
         c.log->LogError("render list still contained item: '%s'", it2.second->name);
 
+    data->notFoundTexture = nullptr;
+
+    if (data->headless)
+        return;
+
     TTF_CloseFont(data->font);
     TTF_Quit();
 
-    data->notFoundTexture = nullptr;
-
     SDL_DestroyRenderer(data->renderer);
     data->renderer = nullptr;
 
@@ -794,56 +1364,97 @@ Graphics::~Graphics()
     data->window = nullptr;
 }
 
-void Graphics::Render(i32 difMs)
+void Graphics::Render(i32 difMs, float alpha)
 {
+    TRACE_ZONE("Graphics::Render");
+
     data->nowMs += difMs;
 
-    // possibly delete single animations
-    for (auto it = data->singleAnimations.cbegin(); it != data->singleAnimations.cend();)
-    {
-        if (data->nowMs >= it->first)
-            data->singleAnimations.erase(it++);
-        else
-            ++it;
-    }
+    data->FinishLoads();
+
+    data->ExpireEffects();
 
     // advance all animations
     for (auto it : data->animations)
         it->AdvanceAnimation(difMs);
 
+    ++data->frameCount;
+
     // Clear the window
-    SDL_RenderClear(data->renderer);
+    if (!data->headless)
+        SDL_RenderClear(data->renderer);
 
     shared_ptr<Player> self = c.players->GetSelfPlayer(false);
     int halfWidth = data->windowW / 2;
     int halfHeight = data->windowH / 2;
 
+    // map pixels to screen pixels, map objects aren't drawn without a self player
+    i32 mapOffsetX = 0, mapOffsetY = 0;
+
+    if (self != nullptr)
+    {
+        mapOffsetX = -self->GetDrawXPixel(alpha) + halfWidth;
+        mapOffsetY = -self->GetDrawYPixel(alpha) + halfHeight;
+    }
+
+    auto drawEffects = [&](const EffectBatch& b)
+    {
+        if (!b.isMap || self != nullptr)
+            data->DrawEffects(b, mapOffsetX, mapOffsetY);
+    };
+
     bool drewMap = false;
+    bool drewWeapons = false;
+    bool drewRadar = false;
+    u32 nextEffects = 0;  // effects are drawn after the other objects on their layer
+
     for (auto it : data->drawnObjs)
     {
+        while (nextEffects < data->effects.size() && data->effects[nextEffects].layer < it.first)
+            drawEffects(data->effects[nextEffects++]);
+
         if (!drewMap && it.first >= Layer_Tiles)
         {
             drewMap = true;
-            c.map->DrawMap();
+            c.map->DrawMap(alpha);
+        }
+
+        if (!drewWeapons && it.first >= Layer_Weapons)
+        {
+            drewWeapons = true;
+            c.ships->DrawWeapons(alpha);
+        }
+
+        if (!drewRadar && it.first >= Layer_Gauges)
+        {
+            drewRadar = true;
+            c.map->DrawRadar(alpha);
         }
 
         if (it.second->isMapImage)
         {
             if (self != nullptr)
-            {
-                it.second->Draw(data->renderer, -self->GetXPixel() + halfWidth,
-                                -self->GetYPixel() + halfHeight);
-            }
+                it.second->Draw(data->renderer, mapOffsetX, mapOffsetY, alpha);
         }
         else
             it.second->Draw(data->renderer);
     }
 
     if (!drewMap)
-        c.map->DrawMap();
+        c.map->DrawMap(alpha);
+
+    if (!drewWeapons)
+        c.ships->DrawWeapons(alpha);
+
+    if (!drewRadar)
+        c.map->DrawRadar(alpha);
+
+    while (nextEffects < data->effects.size())
+        drawEffects(data->effects[nextEffects++]);
 
     // Render the changes
-    SDL_RenderPresent(data->renderer);
+    if (!data->headless)
+        SDL_RenderPresent(data->renderer);
 }
 
 void Graphics::GetScreenSize(u32* w, u32* h)
@@ -852,9 +1463,52 @@ void Graphics::GetScreenSize(u32* w, u32* h)
     *h = data->windowH;
 }
 
+bool Graphics::HasVsync()
+{
+    return data->vsync;
+}
+
+i32 Graphics::GetRefreshRate()
+{
+    i32 rv = 60;
+    SDL_DisplayMode mode;
+
+    if (!data->headless &&
+        SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(data->window), &mode) == 0 &&
+        mode.refresh_rate > 0)
+        rv = mode.refresh_rate;
+
+    return rv;
+}
+
+void Graphics::SaveInterpolationState()
+{
+    for (auto it : data->drawnObjs)
+    {
+        if (it.second->isMapImage)
+        {
+            it.second->prevDest = it.second->dest;
+            it.second->hasPrevDest = true;
+        }
+    }
+}
+
 i32 Graphics::GetFontHeight()
 {
-    return TTF_FontHeight(data->font) + 3;  // TTF_FontHeight = 17, TTF_FontLineSkip=22
+    i32 h = data->headless ? data->HEADLESS_FONT_HEIGHT : TTF_FontHeight(data->font);
+
+    return h + 3;  // TTF_FontHeight = 17, TTF_FontLineSkip=22
+}
+
+bool Graphics::IsHeadless()
+{
+    return data->headless;
+}
+
+void Graphics::GetDrawCounts(u64* frames, u64* draws)
+{
+    *frames = data->frameCount;
+    *draws = data->drawCount;
 }
 
 shared_ptr<DrawnImage> Graphics::MakeDrawnImage(Layer layer, shared_ptr<Image> image, bool isMap)
@@ -873,12 +1527,31 @@ shared_ptr<DrawnImage> Graphics::MakeDrawnAnimation(Layer layer, shared_ptr<Anim
     return rv;
 }
 
-void Graphics::MakeSingleDrawnAnimation(Layer layer, i32 x, i32 y, shared_ptr<Animation> anim)
+void Graphics::MakeSingleDrawnAnimation(Layer layer, i32 x, i32 y, shared_ptr<Animation> anim,
+                                        bool isMapAnimation)
 {
-    shared_ptr<DrawnImage> rv = MakeDrawnAnimation(layer, anim);
-    rv->SetCenterPosition(x, y);
+    auto it = data->effects.begin();
+
+    // the batch for anim on layer, or where it goes to keep them sorted
+    while (it != data->effects.end() &&
+           (it->layer < layer ||
+            (it->layer == layer && (it->anim != anim || it->isMap != isMapAnimation))))
+        ++it;
+
+    if (it == data->effects.end() || it->anim != anim || it->layer != layer ||
+        it->isMap != isMapAnimation)
+    {
+        EffectBatch b;
+        b.anim = anim;
+        b.layer = layer;
+        b.isMap = isMapAnimation;
+
+        it = data->effects.insert(it, b);
+    }
 
-    data->singleAnimations.insert(make_pair(data->nowMs + anim->animMs, rv));
+    it->centerX.push_back(x);
+    it->centerY.push_back(y);
+    it->startMs.push_back(data->nowMs);
 }
 
 shared_ptr<DrawnText> Graphics::MakeDrawnText(Layer layer, TextColor color, const char* utf8,
@@ -889,6 +1562,11 @@ shared_ptr<DrawnText> Graphics::MakeDrawnText(Layer layer, TextColor color, cons
     return lines[0];
 }
 
+void Graphics::WrapText(vector<TextSpan>& store, const char* utf8, i32 wrapPixels)
+{
+    data->WrapText(store, utf8, wrapPixels, 0);
+}
+
 void Graphics::MakeDrawnChat(vector<shared_ptr<DrawnText>>& store, Layer layer, TextColor color,
                              i32 wrapPixels, const char* playerNameUtf8, const char* utf8)
 {
@@ -902,12 +1580,43 @@ shared_ptr<Image> Graphics::LoadImage(const char* filename)
 
 shared_ptr<Image> Graphics::LoadImage(const char* filename, u32 w, u32 h)
 {
-    shared_ptr<ManagedTexture> mt = data->LoadTexture(filename);
-    shared_ptr<Image> rv = make_shared<Image>(w, h, mt, filename);
+    weak_ptr<Image>& cached = data->imageCache[make_tuple(string(filename), w, h)];
+    shared_ptr<Image> rv = cached.lock();
+
+    if (rv == nullptr)
+    {
+        shared_ptr<LoadJob> job = make_shared<LoadJob>();
+        job->filename = filename;
+
+        rv = data->QueueLoad(job, w, h, filename);
+        cached = rv;
+    }
 
     return rv;
 }
 
+shared_ptr<Image> Graphics::LoadImageFromMemory(const char* name, const u8* bytes, i32 len, u32 w,
+                                                u32 h)
+{
+    shared_ptr<LoadJob> job = make_shared<LoadJob>();
+    job->bytes.assign(bytes, bytes + len);
+
+    return data->QueueLoad(job, w, h, name);
+}
+
+shared_ptr<Image> Graphics::MakeImageFromPixels(const char* name, i32 w, i32 h, const u8* rgba)
+{
+    SDL_Surface* surface = data->MakeMemorySurface(w, h);
+
+    // the memory surface's masks make its bytes rgba on any endianness
+    for (i32 y = 0; y < h; ++y)
+        memcpy((u8*)surface->pixels + y * surface->pitch, rgba + y * w * 4, w * 4);
+
+    shared_ptr<ManagedTexture> mt = data->SurfaceToManagedTexture(surface, name);
+
+    return make_shared<Image>(1, 1, mt, name);
+}
+
 shared_ptr<Animation> Graphics::InitAnimation(shared_ptr<Image> i, u32 animMs, u32 animFrameOffset,
                                               u32 animNumFrames)
 {
@@ -923,3 +1632,20 @@ void Graphics::DrawImageFrame(shared_ptr<Image> i, i32 frame, i32 pixelX, i32 pi
 {
     data->DrawImageFrame(i, frame, pixelX, pixelY);
 }
+
+void Graphics::DrawRects(const SDL_Rect* rects, i32 count, TextColor color)
+{
+    if (count > 0)
+    {
+        ++data->drawCount;
+
+        if (!data->headless)
+        {
+            SDL_Color col = data->colorMap.find(color)->second;
+
+            SDL_SetRenderDrawColor(data->renderer, col.r, col.g, col.b, col.a);
+            SDL_RenderFillRects(data->renderer, rects, count);
+            SDL_SetRenderDrawColor(data->renderer, 0, 0, 0, 255);  // back to the clear color
+        }
+    }
+}
@@ -2,18 +2,431 @@
 #include "Config.h"
 #include <map>
 #include <stdarg.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 using std::map;
 
 static map<LogLevel, const char*> LOG_PREFIX = {
     {LOG_DRIVEL, "[D]"}, {LOG_INFO, "[I]"}, {LOG_ERROR, "[ERROR]"},
 };
 
-Logman::Logman(Client& client) : Module(client)
+// names for log::print_level
+static map<LogLevel, const char*> LOG_LEVEL_NAMES = {
+    {LOG_DRIVEL, "drivel"}, {LOG_INFO, "info"}, {LOG_ERROR, "error"},
+};
+
+
+static const u32 LOG_RING_SLOTS = 2048;  // power of two
+static const i32 LOG_MAX_ARGS = 12;
+static const i32 LOG_STRING_BYTES = 256;      // %s arguments are copied here, and truncated
+static const u16 LOG_EMPTY_STRING = 0xFFFF;  // string offset for a truncated-away argument
+static const i32 LOG_IDLE_WAIT_MILLS = 100;  // writer thread wait for a wakeup, as a fallback
+
+enum LogArgType
+{
+    LogArg_Signed,
+    LogArg_Unsigned,
+    LogArg_Double,
+    LogArg_String,
+    LogArg_Pointer,
+};
+
+struct LogArg
+{
+    LogArgType type;
+
+    union
+    {
+        i64 i;
+        u64 u;
+        double d;
+        u16 stringOffset;
+        const void* p;
+    };
+};
+
+struct LogRecord
+{
+    // Vyukov bounded queue: equal to the ring position when free, position + 1 once written
+    std::atomic<u32> sequence;
+
+    u64 microseconds;  // since the log was created
+    LogLevel level;
+    const char* format;  // nullptr if the message was formatted by the caller, into strings
+    i32 numArgs;
+    LogArg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_BYTES];
+};
+
+struct LogmanData
+{
+    LogRecord* ring = nullptr;
+    std::atomic<u32> writePos;  // next position to claim, for the callers
+    std::atomic<u32> readPos;   // next position to write out, advanced by the writer
+    std::atomic<u64> dropped;
+    u64 droppedReported = 0;  // writer side
+
+    std::chrono::steady_clock::time_point start;
+    std::thread writer;
+    std::atomic<bool> stopWriter;
+
+    // the writer waits for records here while the ring is empty, so idle clients don't poll
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> writerWaiting;
+
+    LogmanData() : writePos(0), readPos(0), dropped(0), stopWriter(false), writerWaiting(false)
+    {
+        ring = new LogRecord[LOG_RING_SLOTS];
+
+        for (u32 i = 0; i < LOG_RING_SLOTS; ++i)
+            ring[i].sequence.store(i, std::memory_order_relaxed);
+
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~LogmanData() { delete[] ring; }
+
+    bool HasRecord();
+    void WakeWriter();
+};
+
+enum LogLength
+{
+    Length_None,
+    Length_hh,
+    Length_h,
+    Length_l,
+    Length_ll,
+    Length_z,
+    Length_j,
+    Length_t,
+    Length_L,
+};
+
+// one printf conversion, from the '%' up to and including the conversion character
+struct LogSpec
+{
+    const char* start;
+    const char* lengthStart;  // where the length modifier is (or would be)
+    const char* end;          // one past the conversion character
+    i32 numStars;             // '*' widths and precisions, each consumes an int argument
+    LogLength length;
+    char conversion;  // 0 if the spec is incomplete
+};
+
+// parse the conversion starting at p, which points to a '%'
+static void ParseSpec(const char* p, LogSpec* spec)
+{
+    spec->start = p++;
+    spec->numStars = 0;
+    spec->length = Length_None;
+
+    while (*p && strchr("-+ #0", *p))
+        ++p;
+
+    // width, then precision
+    for (i32 part = 0; part < 2; ++part)
+    {
+        if (part == 1)
+        {
+            if (*p != '.')
+                break;
+
+            ++p;
+        }
+
+        if (*p == '*')
+        {
+            ++spec->numStars;
+            ++p;
+        }
+        else
+        {
+            while (*p >= '0' && *p <= '9')
+                ++p;
+        }
+    }
+
+    spec->lengthStart = p;
+
+    if (p[0] == 'h' && p[1] == 'h')
+    {
+        spec->length = Length_hh;
+        p += 2;
+    }
+    else if (p[0] == 'l' && p[1] == 'l')
+    {
+        spec->length = Length_ll;
+        p += 2;
+    }
+    else if (*p && strchr("hlzjtL", *p))
+    {
+        static map<char, LogLength> SINGLE_LENGTHS = {
+            {'h', Length_h}, {'l', Length_l}, {'z', Length_z},
+            {'j', Length_j}, {'t', Length_t}, {'L', Length_L},
+        };
+
+        spec->length = SINGLE_LENGTHS[*p++];
+    }
+
+    spec->conversion = *p;
+    spec->end = *p ? p + 1 : p;
+}
+
+static i64 TakeSigned(LogLength length, va_list* args)
+{
+    i64 rv = 0;
+
+    if (length == Length_l)
+        rv = va_arg(*args, long);
+    else if (length == Length_ll)
+        rv = va_arg(*args, long long);
+    else if (length == Length_z)
+        rv = va_arg(*args, ptrdiff_t);  // the signed type of size_t's width
+    else if (length == Length_j)
+        rv = va_arg(*args, intmax_t);
+    else if (length == Length_t)
+        rv = va_arg(*args, ptrdiff_t);
+    else if (length == Length_hh)
+        rv = (signed char)va_arg(*args, int);
+    else if (length == Length_h)
+        rv = (short)va_arg(*args, int);
+    else
+        rv = va_arg(*args, int);
+
+    return rv;
+}
+
+static u64 TakeUnsigned(LogLength length, va_list* args)
+{
+    u64 rv = 0;
+
+    if (length == Length_l)
+        rv = va_arg(*args, unsigned long);
+    else if (length == Length_ll)
+        rv = va_arg(*args, unsigned long long);
+    else if (length == Length_z)
+        rv = va_arg(*args, size_t);
+    else if (length == Length_j)
+        rv = va_arg(*args, uintmax_t);
+    else if (length == Length_t)
+        rv = (u64)va_arg(*args, ptrdiff_t);
+    else if (length == Length_hh)
+        rv = (unsigned char)va_arg(*args, unsigned int);
+    else if (length == Length_h)
+        rv = (unsigned short)va_arg(*args, unsigned int);
+    else
+        rv = va_arg(*args, unsigned int);
+
+    return rv;
+}
+
+// copy a string argument into the record's string area
+static void StoreString(LogRecord* r, i32* stringBytes, const char* str, LogArg* arg)
+{
+    i32 space = LOG_STRING_BYTES - *stringBytes;
+
+    if (str == nullptr)
+        str = "(null)";
+
+    if (space <= 1)
+        arg->stringOffset = LOG_EMPTY_STRING;
+    else
+    {
+        i32 len = strlen(str);
+
+        if (len > space - 1)
+            len = space - 1;
+
+        memcpy(r->strings + *stringBytes, str, len);
+        r->strings[*stringBytes + len] = 0;
+        arg->stringOffset = *stringBytes;
+        *stringBytes += len + 1;
+    }
+}
+
+// store the arguments by value in the record, false if the format uses something the record can't
+// hold (too many arguments, %n, wide strings or an unknown conversion)
+static bool StoreArgs(LogRecord* r, const char* format, va_list* args)
+{
+    bool rv = true;
+    i32 stringBytes = 0;
+
+    r->numArgs = 0;
+
+    for (const char* p = format; rv && *p; ++p)
+    {
+        if (*p != '%')
+            continue;
+
+        if (p[1] == '%')
+        {
+            ++p;
+            continue;
+        }
+
+        LogSpec spec;
+        ParseSpec(p, &spec);
+        p = spec.end - 1;
+
+        if (r->numArgs + spec.numStars + 1 > LOG_MAX_ARGS)
+            rv = false;
+        else
+        {
+            for (i32 i = 0; i < spec.numStars; ++i)
+            {
+                LogArg* arg = &r->args[r->numArgs++];
+                arg->type = LogArg_Signed;
+                arg->i = va_arg(*args, int);
+            }
+
+            LogArg* arg = &r->args[r->numArgs++];
+            char conv = spec.conversion;
+
+            if (conv == 'd' || conv == 'i')
+            {
+                arg->type = LogArg_Signed;
+                arg->i = TakeSigned(spec.length, args);
+            }
+            else if (conv == 'o' || conv == 'u' || conv == 'x' || conv == 'X')
+            {
+                arg->type = LogArg_Unsigned;
+                arg->u = TakeUnsigned(spec.length, args);
+            }
+            else if (conv == 'c' && spec.length == Length_None)
+            {
+                arg->type = LogArg_Signed;
+                arg->i = va_arg(*args, int);
+            }
+            else if (conv && strchr("fFeEgGaA", conv))
+            {
+                arg->type = LogArg_Double;
+
+                if (spec.length == Length_L)
+                    arg->d = (double)va_arg(*args, long double);
+                else
+                    arg->d = va_arg(*args, double);
+            }
+            else if (conv == 's' && spec.length == Length_None)
+            {
+                arg->type = LogArg_String;
+                StoreString(r, &stringBytes, va_arg(*args, const char*), arg);
+            }
+            else if (conv == 'p')
+            {
+                arg->type = LogArg_Pointer;
+                arg->p = va_arg(*args, const void*);
+            }
+            else
+                rv = false;
+        }
+    }
+
+    return rv;
+}
+
+// format one conversion, with the length modifier replaced by lengthMod
+template <typename T>
+static void AppendSpec(string* out, const LogSpec* spec, const char* lengthMod, const i32* stars,
+                       T value)
+{
+    char fmt[64];
+    char buf[512];
+    i32 prefixLen = spec->lengthStart - spec->start;
+
+    if (prefixLen > 40)
+        prefixLen = 40;
+
+    snprintf(fmt, sizeof(fmt), "%.*s%s%c", prefixLen, spec->start, lengthMod, spec->conversion);
+
+    if (spec->numStars == 0)
+        snprintf(buf, sizeof(buf), fmt, value);
+    else if (spec->numStars == 1)
+        snprintf(buf, sizeof(buf), fmt, stars[0], value);
+    else
+        snprintf(buf, sizeof(buf), fmt, stars[0], stars[1], value);
+
+    *out += buf;
+}
+
+// the writer thread side of StoreArgs
+static void FormatRecord(const LogRecord* r, string* out)
 {
-    const char* logFilename = c.cfg->GetStringNoDefault("log", "filename");
+    if (r->format == nullptr)
+        *out += r->strings;
+    else
+    {
+        i32 argIndex = 0;
+
+        for (const char* p = r->format; *p; ++p)
+        {
+            if (*p != '%')
+            {
+                *out += *p;
+                continue;
+            }
+
+            if (p[1] == '%')
+            {
+                *out += '%';
+                ++p;
+                continue;
+            }
+
+            LogSpec spec;
+            ParseSpec(p, &spec);
+            p = spec.end - 1;
+
+            i32 stars[2] = {};
+
+            for (i32 i = 0; i < spec.numStars; ++i)
+                stars[i] = (i32)r->args[argIndex++].i;
+
+            const LogArg* arg = &r->args[argIndex++];
+
+            if (arg->type == LogArg_Signed && spec.conversion == 'c')
+                AppendSpec(out, &spec, "", stars, (int)arg->i);
+            else if (arg->type == LogArg_Signed)
+                AppendSpec(out, &spec, "ll", stars, (long long)arg->i);
+            else if (arg->type == LogArg_Unsigned)
+                AppendSpec(out, &spec, "ll", stars, (unsigned long long)arg->u);
+            else if (arg->type == LogArg_Double)
+                AppendSpec(out, &spec, "", stars, arg->d);
+            else if (arg->type == LogArg_Pointer)
+                AppendSpec(out, &spec, "", stars, arg->p);
+            else
+            {
+                const char* str = "";
+
+                if (arg->stringOffset != LOG_EMPTY_STRING)
+                    str = r->strings + arg->stringOffset;
+
+                AppendSpec(out, &spec, "", stars, str);
+            }
+        }
+    }
+}
+
+Logman::Logman(Client& client) : Module(client), data(make_shared<LogmanData>())
+{
+    const char* logFilename = c.cfg->Values().logFilename.c_str();
+    const char* printLevel = c.cfg->Values().logPrintLevel.c_str();
+
+    for (auto it : LOG_LEVEL_NAMES)
+    {
+        if (strcasecmp(printLevel, it.second) == 0)
+        {
+            logLevelPrint = it.first;
 
-    if (logFilename == nullptr)
-        logFilename = "log.txt";
+            if (logLevelPrintStderr < logLevelPrint)
+                logLevelPrintStderr = logLevelPrint;
+        }
+    }
 
     f = fopen(logFilename, "w");
 
@@ -22,11 +435,26 @@ Logman::Logman(Client& client) : Module(client)
     else
         fprintf(f, "\n");
 
+    data->writer = std::thread([this]() { WriterLoop(); });
+
     LogHeader();
+
+    // from resolving the config, which happens before the log exists
+    vector<pair<bool, string>> configMessages;
+    c.cfg->TakeDeferredMessages(&configMessages);
+
+    for (auto& msg : configMessages)
+        Log(msg.first ? LOG_ERROR : LOG_INFO, "%s", msg.second.c_str());
 }
 
 Logman::~Logman()
 {
+    data->stopWriter.store(true);
+    data->WakeWriter();
+
+    if (data->writer.joinable())
+        data->writer.join();
+
     if (f)
     {
         fclose(f);
@@ -97,45 +525,190 @@ void Logman::FatalError(const char* format, ...)
 
     va_end(args);
 
+    Flush();
     PrintStackTrace();
     abort();
 }
 
+// a record is ready at readPos
+bool LogmanData::HasRecord()
+{
+    u32 pos = readPos.load(std::memory_order_relaxed);
+
+    return ring[pos & (LOG_RING_SLOTS - 1)].sequence.load(std::memory_order_acquire) == pos + 1;
+}
+
+void LogmanData::WakeWriter()
+{
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wake.notify_one();
+}
+
 void Logman::LogVaList(LogLevel level, const char* format, va_list args)
 {
-    if (level >= logLevelPrint || level >= logLevelPrintStderr)
+    if (level >= logLevelPrint || level >= logLevelPrintStderr || level >= logLevelSave)
     {
-        va_list args_copy;
-        va_copy(args_copy, args);  // copy in case we're printing to both terminal and file
+        LogmanData* d = data.get();
+        LogRecord* r = nullptr;
+        u32 pos = d->writePos.load(std::memory_order_relaxed);
 
-        if (level >= logLevelPrintStderr)
+        // claim a slot
+        while (r == nullptr)
         {
-            fprintf(stderr, "%s ", LOG_PREFIX[level]);
-            vfprintf(stderr, format, args_copy);
-            fprintf(stderr, "\n");
+            LogRecord* slot = &d->ring[pos & (LOG_RING_SLOTS - 1)];
+            i32 diff = (i32)(slot->sequence.load(std::memory_order_acquire) - pos);
+
+            if (diff == 0)
+            {
+                if (d->writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    r = slot;
+            }
+            else if (diff < 0)
+                break;  // full
+            else
+                pos = d->writePos.load(std::memory_order_relaxed);
         }
+
+        if (r == nullptr)
+            d->dropped.fetch_add(1, std::memory_order_relaxed);
         else
         {
-            printf("%s ", LOG_PREFIX[level]);
-            vprintf(format, args_copy);
-            printf("\n");
+            r->microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() - d->start).count();
+            r->level = level;
+            r->format = format;
+
+            va_list argsCopy;
+            va_copy(argsCopy, args);
+
+            if (!StoreArgs(r, format, &argsCopy))
+            {
+                // something the record can't hold by value, format it here instead
+                vsnprintf(r->strings, sizeof(r->strings), format, args);
+                r->format = nullptr;
+            }
+
+            va_end(argsCopy);
+
+            r->sequence.store(pos + 1, std::memory_order_release);
+
+            // pairs with the fence in WriterLoop: either the writer sees this record before it
+            // waits, or this sees that it's waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (d->writerWaiting.load(std::memory_order_relaxed))
+                d->WakeWriter();
+        }
+    }
+}
+
+void Logman::Flush()
+{
+    LogmanData* d = data.get();
+
+    if (!d->writer.joinable())
+        WriteAvailable();  // the writer isn't running yet (or anymore)
+    else
+    {
+        u32 target = d->writePos.load(std::memory_order_acquire);
+
+        while ((i32)(d->readPos.load(std::memory_order_acquire) - target) < 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+u64 Logman::GetDroppedCount()
+{
+    return data->dropped.load(std::memory_order_relaxed);
+}
+
+void Logman::WriterLoop()
+{
+    LogmanData* d = data.get();
+
+    while (!d->stopWriter.load())
+    {
+        if (!WriteAvailable())
+        {
+            std::unique_lock<std::mutex> lock(d->wakeMutex);
+
+            d->writerWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!d->HasRecord() && !d->stopWriter.load())
+                d->wake.wait_for(lock, std::chrono::milliseconds(LOG_IDLE_WAIT_MILLS));
+
+            d->writerWaiting.store(false, std::memory_order_relaxed);
         }
+    }
+
+    // whatever was logged before stopping
+    WriteAvailable();
+}
+
+// write out the records in the ring, false if there weren't any
+bool Logman::WriteAvailable()
+{
+    LogmanData* d = data.get();
+    bool rv = false;
+    bool wroteError = false;
+    string text;
+
+    for (;;)
+    {
+        u32 pos = d->readPos.load(std::memory_order_relaxed);
+        LogRecord* r = &d->ring[pos & (LOG_RING_SLOTS - 1)];
+
+        if (r->sequence.load(std::memory_order_acquire) != pos + 1)
+            break;
+
+        LogLevel level = r->level;
+        u64 ms = r->microseconds / 1000;
+        text.clear();
+        FormatRecord(r, &text);
 
-        va_end(args_copy);
+        // the slot can be reused once the record is formatted
+        r->sequence.store(pos + LOG_RING_SLOTS, std::memory_order_release);
+        d->readPos.store(pos + 1, std::memory_order_release);
+        rv = true;
+
+        if (level >= logLevelPrintStderr)
+            fprintf(stderr, "%s %s\n", LOG_PREFIX[level], text.c_str());
+        else if (level >= logLevelPrint)
+            printf("%s %s\n", LOG_PREFIX[level], text.c_str());
+
+        if (level >= logLevelSave && f != nullptr)
+            fprintf(f, "%s %llu.%03llu %s\n", LOG_PREFIX[level], (unsigned long long)(ms / 1000),
+                    (unsigned long long)(ms % 1000), text.c_str());
+
+        if (level >= LOG_ERROR)
+            wroteError = true;
     }
 
-    if (level >= logLevelSave && f != nullptr)
+    u64 dropped = d->dropped.load(std::memory_order_relaxed);
+
+    if (dropped != d->droppedReported)
     {
-        fprintf(f, "%s ", LOG_PREFIX[level]);
-        vfprintf(f, format, args);
-        fprintf(f, "\n");
+        unsigned long long count = dropped - d->droppedReported;
+        d->droppedReported = dropped;
+
+        fprintf(stderr, "%s %llu log messages dropped (log buffer full)\n", LOG_PREFIX[LOG_ERROR],
+                count);
+
+        if (f != nullptr)
+            fprintf(f, "%s %llu log messages dropped (log buffer full)\n", LOG_PREFIX[LOG_ERROR],
+                    count);
+
+        wroteError = true;
     }
 
-    if (level >= LOG_ERROR)
+    if (wroteError)
     {
         fflush(stdout);
 
         if (f != nullptr)
             fflush(f);
     }
+
+    return rv;
 }
@@ -3,8 +3,18 @@
 #include "Graphics.h"
 #include "Packets.h"
 #include "Net.h"
+#include "Trace.h"
+#include "dcollision.h"
 #include "zlib.h"
-#include <fstream>
+#include <sys/stat.h>
+#include <thread>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 
 unique_ptr<u8[]> ZlibDecompress(Client& c, const u8* src, int len, i32* decompressedLen)
@@ -39,28 +49,276 @@ unique_ptr<u8[]> ZlibDecompress(Client& c, const u8* src, int len, i32* decompre
     return rv;
 }
 
-struct TileStruct
+// a whole file in memory: memory-mapped where possible, otherwise read in one go
+struct MappedFile
+{
+    const u8* bytes = nullptr;
+    i32 len = 0;
+
+    ~MappedFile() { Close(); }
+
+    bool Open(const char* path);
+    void Close();
+
+   private:
+    bool mapped = false;
+    vector<u8> buffer;  // if not mapped
+};
+
+bool MappedFile::Open(const char* path)
+{
+    bool rv = false;
+
+    Close();
+
+#ifndef WIN32
+    int fd = open(path, O_RDONLY);
+
+    if (fd >= 0)
+    {
+        struct stat st;
+
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (m != MAP_FAILED)
+            {
+                bytes = (const u8*)m;
+                len = (i32)st.st_size;
+                mapped = true;
+                rv = true;
+            }
+        }
+
+        close(fd);
+    }
+#endif
+
+    if (!mapped)
+    {
+        FILE* f = fopen(path, "rb");
+
+        if (f)
+        {
+            fseek(f, 0, SEEK_END);
+            long size = ftell(f);
+            fseek(f, 0, SEEK_SET);
+
+            if (size >= 0)
+            {
+                buffer.resize(size);
+                rv = fread(buffer.data(), 1, size, f) == (size_t)size;
+                bytes = buffer.data();
+                len = (i32)size;
+            }
+
+            fclose(f);
+        }
+    }
+
+    return rv;
+}
+
+void MappedFile::Close()
+{
+#ifndef WIN32
+    if (mapped)
+        munmap((void*)bytes, len);
+#endif
+
+    mapped = false;
+    bytes = nullptr;
+    len = 0;
+    buffer.clear();
+}
+
+// the 1024x1024 tiles in 32x32 chunks, only chunks with tiles in them are stored
+// an occupancy bit per chunk lets drawing (and anything else scanning the map) skip empty space
+struct TileMap
 {
-    unsigned x : 12;  // range 0-1023, upper two bits should be 0
-    unsigned y : 12;
-    unsigned tile : 8;
+    static const i32 MAP_TILES = 1024;  // per side
+    static const i32 CHUNK_SHIFT = 5;
+    static const i32 CHUNK_TILES = 1 << CHUNK_SHIFT;  // per side
+    static const i32 CHUNK_BYTES = CHUNK_TILES * CHUNK_TILES;
+    static const i32 CHUNKS = MAP_TILES / CHUNK_TILES;  // per side, so a row of bits is a u32
+
+    u32 occupied[CHUNKS] = {};  // bit cx of occupied[cy]
+    u16 chunkSlot[CHUNKS * CHUNKS] = {};  // index into chunks, for occupied chunks
+    vector<u8> chunks;
+    i32 numChunks = 0;
+
+    // the tile data is packed 4 byte records: x (12 bits), y (12 bits), tile (8 bits)
+    // returns false if any coordinate was out of bounds
+    bool Build(const u8* records, i32 numRecords);
+
+    bool IsChunkOccupied(i32 cx, i32 cy) const { return (occupied[cy] >> cx) & 1; }
+
+    // the chunk's tiles in rows, or nullptr if it's empty
+    const u8* GetChunk(i32 cx, i32 cy) const
+    {
+        return IsChunkOccupied(cx, cy) ? &chunks[chunkSlot[cy * CHUNKS + cx] * CHUNK_BYTES]
+                                       : nullptr;
+    }
+
+    // 0 outside of the map
+    u8 GetTile(i32 x, i32 y) const
+    {
+        u8 rv = 0;
+
+        if (x >= 0 && y >= 0 && x < MAP_TILES && y < MAP_TILES)
+        {
+            const u8* chunk = GetChunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+
+            if (chunk)
+                rv = chunk[(y & (CHUNK_TILES - 1)) * CHUNK_TILES + (x & (CHUNK_TILES - 1))];
+        }
+
+        return rv;
+    }
 };
 
+bool TileMap::Build(const u8* records, i32 numRecords)
+{
+    const u32 COORD_MASK = MAP_TILES - 1;
+    u32 badCoords = 0;
+
+    // first pass finds the chunks in use, any coordinate >= 1024 is an error after the loop
+    for (i32 i = 0; i < numRecords; ++i)
+    {
+        const u8* r = records + 4 * i;
+        u32 x = r[0] | ((r[1] & 0x0F) << 8);
+        u32 y = (r[1] >> 4) | (r[2] << 4);
+
+        badCoords |= (x | y) & ~COORD_MASK;
+        occupied[(y & COORD_MASK) >> CHUNK_SHIFT] |= 1u << ((x & COORD_MASK) >> CHUNK_SHIFT);
+    }
+
+    numChunks = 0;
+
+    for (i32 cy = 0; cy < CHUNKS; ++cy)
+        for (i32 cx = 0; cx < CHUNKS; ++cx)
+            if (IsChunkOccupied(cx, cy))
+                chunkSlot[cy * CHUNKS + cx] = numChunks++;
+
+    chunks.assign(numChunks * CHUNK_BYTES, 0);
+
+    // second pass stores the tiles
+    for (i32 i = 0; i < numRecords; ++i)
+    {
+        const u8* r = records + 4 * i;
+        u32 x = (r[0] | ((r[1] & 0x0F) << 8)) & COORD_MASK;
+        u32 y = ((r[1] >> 4) | (r[2] << 4)) & COORD_MASK;
+        u32 slot = chunkSlot[(y >> CHUNK_SHIFT) * CHUNKS + (x >> CHUNK_SHIFT)];
+
+        chunks[slot * CHUNK_BYTES + (y & (CHUNK_TILES - 1)) * CHUNK_TILES +
+               (x & (CHUNK_TILES - 1))] = r[3];
+    }
+
+    return badCoords == 0;
+}
+
+// crc32s of the map files in a zone dir, so files that haven't changed aren't hashed again
+// saved in the zone dir as lines of "size mtime crc32 filename"
+static const char* CRC_INDEX_FILENAME = "map_crc_index.txt";
+
+struct CrcIndexEntry
+{
+    u64 size;
+    i64 mtime;
+    u32 crc32;
+};
+
+struct CrcIndex
+{
+    string dir;  // the zone dir the entries are from
+    map<string, CrcIndexEntry> entries;  // by filename
+
+    void Load(const string& zoneDir);
+    void Save();
+};
+
+void CrcIndex::Load(const string& zoneDir)
+{
+    dir = zoneDir;
+    entries.clear();
+
+    string path = dir + CRC_INDEX_FILENAME;
+    FILE* f = fopen(path.c_str(), "r");
+
+    if (f)
+    {
+        char line[512];
+
+        while (fgets(line, sizeof(line), f))
+        {
+            unsigned long long size = 0;
+            long long mtime = 0;
+            unsigned int crc = 0;
+            int nameStart = 0;
+
+            if (sscanf(line, "%llu %lld %x %n", &size, &mtime, &crc, &nameStart) == 3 &&
+                nameStart > 0)
+            {
+                string name = line + nameStart;
+
+                while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+                    name.pop_back();
+
+                if (!name.empty())
+                    entries[name] = {size, mtime, crc};
+            }
+        }
+
+        fclose(f);
+    }
+}
+
+void CrcIndex::Save()
+{
+    string path = dir + CRC_INDEX_FILENAME;
+    FILE* f = fopen(path.c_str(), "w");
+
+    if (f)
+    {
+        for (auto& it : entries)
+            fprintf(f, "%llu %lld %08x %s\n", (unsigned long long)it.second.size,
+                    (long long)it.second.mtime, it.second.crc32, it.first.c_str());
+
+        fclose(f);
+    }
+}
+
 struct MapData
 {
-    const int MAP_TILES_WIDTH = 1024;
-    const int MAP_TILES_HEIGHT = 1024;
     const int PIXELS_PER_TILE = 16;
 
     MapData(Client& c) : c(c) {}
 
     Client& c;
     bool hasTileset = false;
-    unique_ptr<u8[]> theMap;
+    unique_ptr<TileMap> theMap;
+    unique_ptr<CollisionMap> collisionMap;  // built from theMap
+
+    // the radar is the whole map scaled down, a pixel for each 8x8 block of tiles
+    static const i32 RADAR_TILES_PER_PIXEL = 8;
+    static const i32 RADAR_PIXELS = TileMap::MAP_TILES / RADAR_TILES_PER_PIXEL;
+    static const i32 RADAR_MARGIN = 10;  // from the bottom right of the screen
+    static const i32 RADAR_MAX_THREADS = 4;
+    shared_ptr<Image> radarImage;
+    vector<shared_ptr<Player>> radarPlayers;  // reused every frame
+    vector<SDL_Rect> radarTeamDots;
+    vector<SDL_Rect> radarEnemyDots;
 
     shared_ptr<Image> defaultTileset = c.graphics->LoadImage("default_tileset", 19, 10);
     shared_ptr<Image> curTileset;
 
+    map<string, CrcIndex> crcIndexes;  // by dir, loaded on first use
+
+    // the shared store key of the map being downloaded, from the map info packet
+    u32 downloadChecksum = 0;
+    u32 downloadCompressedSize = 0;
+
     void GotMapInfo(const char* filename, u32 checksum, u32 compressedSize)
     {
         // check if it exists
@@ -71,23 +329,76 @@ struct MapData
 
         string mapFilename = dir + filename;
 
-        if (!ValidateFile(mapFilename.c_str(), checksum))
+        string storeDir = c.connection->GetMapStoreDir();
+        string storeFilename = GetStoreFilename(checksum, compressedSize);
+
+        if (ValidateFile(dir, filename, checksum))
+        {
+            c.log->LogDrivel("Existing map file '%s' had correct crc32", mapFilename.c_str());
+
+            c.map->SetMapPath(mapFilename.c_str());
+        }
+        else if (ValidateFile(storeDir, storeFilename.c_str(), checksum))
+        {
+            // another zone (or an earlier version of this one) had the same map
+            c.log->LogDrivel("Map file '%s' found in the shared map store as '%s'",
+                             mapFilename.c_str(), storeFilename.c_str());
+
+            if (LinkOrCopy(storeDir + storeFilename, mapFilename))
+                UpdateCrcIndex(dir, filename, checksum);
+
+            c.map->SetMapPath((storeDir + storeFilename).c_str());
+        }
+        else
         {
             c.log->LogDrivel("Requesting download of map file '%s'", mapFilename.c_str());
 
-            // mapCompressedSize = compressedSize;
+            downloadChecksum = checksum;
+            downloadCompressedSize = compressedSize;
             c.net->ExpectStreamTransfer(dlAbortFunc, dlProgressFunc);
 
             // download new version of map
             PacketInstance pi("map request");
             c.net->SendReliablePacket(&pi);
         }
-        else
+    }
+
+    // maps in the shared store are named by their content
+    string GetStoreFilename(u32 checksum, u32 compressedSize)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%08x-%u.lvl", checksum, compressedSize);
+
+        return buf;
+    }
+
+    // make the file at 'to' the same as the one at 'from', with a hard link where possible
+    bool LinkOrCopy(const string& from, const string& to)
+    {
+        bool rv = false;
+
+        remove(to.c_str());
+
+#ifndef WIN32
+        rv = link(from.c_str(), to.c_str()) == 0;
+#endif
+
+        if (!rv)
         {
-            c.log->LogDrivel("Existing map file '%s' had correct crc32", mapFilename.c_str());
+            MappedFile src;
+            FILE* f = nullptr;
 
-            c.map->SetMapPath(mapFilename.c_str());
+            if (src.Open(from.c_str()) && (f = fopen(to.c_str(), "wb")) != nullptr)
+            {
+                rv = src.len == 0 || fwrite(src.bytes, src.len, 1, f) == 1;
+                fclose(f);
+            }
+
+            if (!rv)
+                c.log->LogError("Error copying '%s' to '%s'", from.c_str(), to.c_str());
         }
+
+        return rv;
     }
 
     std::function<void()> dlAbortFunc = [this]()
@@ -101,10 +412,10 @@ struct MapData
         c.log->LogDrivel("Download Progress: %d/%d (%0.1f%%)", got, total, (100.0 * got / total));
     };
 
-    bool ValidateFile(const char* path, u32 crc32)
+    bool ValidateFile(const string& dir, const char* filename, u32 crc32)
     {
         u32 mycrc = 0;
-        bool rv = GetCrc32(path, &mycrc);
+        bool rv = GetIndexedCrc32(dir, filename, &mycrc);
 
         if (!rv || (crc32 != mycrc))
             rv = false;
@@ -112,6 +423,72 @@ struct MapData
         return rv;
     }
 
+    // the crc32 from the zone dir's index if the file's size and mtime haven't changed, otherwise
+    // it's computed and the index is updated
+    bool GetIndexedCrc32(const string& dir, const string& filename, u32* storeCrc32)
+    {
+        string path = dir + filename;
+        struct stat st;
+        bool rv = false;
+
+        CrcIndex* index = GetCrcIndex(dir);
+
+        if (stat(path.c_str(), &st) == 0)
+        {
+            auto it = index->entries.find(filename);
+
+            if (it != index->entries.end() && it->second.size == (u64)st.st_size &&
+                it->second.mtime == (i64)st.st_mtime)
+            {
+                *storeCrc32 = it->second.crc32;
+                rv = true;
+            }
+            else if (GetCrc32(path.c_str(), storeCrc32))
+            {
+                UpdateCrcIndex(dir, filename, *storeCrc32);
+                rv = true;
+            }
+        }
+
+        return rv;
+    }
+
+    // record the crc32 of a file that was just written or hashed
+    void UpdateCrcIndex(const string& dir, const string& filename, u32 crc32)
+    {
+        string path = dir + filename;
+        struct stat st;
+
+        CrcIndex* index = GetCrcIndex(dir);
+
+        if (stat(path.c_str(), &st) == 0)
+        {
+            CrcIndexEntry entry = {(u64)st.st_size, (i64)st.st_mtime, crc32};
+            auto it = index->entries.find(filename);
+
+            // validating an unchanged file finds the entry it already has, nothing to save
+            if (it == index->entries.end() || it->second.size != entry.size ||
+                it->second.mtime != entry.mtime || it->second.crc32 != entry.crc32)
+            {
+                index->entries[filename] = entry;
+                index->Save();
+            }
+        }
+    }
+
+    CrcIndex* GetCrcIndex(const string& dir)
+    {
+        auto it = crcIndexes.find(dir);
+
+        if (it == crcIndexes.end())
+        {
+            it = crcIndexes.insert(make_pair(dir, CrcIndex())).first;
+            it->second.Load(dir);
+        }
+
+        return &it->second;
+    }
+
     bool GetCrc32(const char* filename, u32* storeCrc32)
     {
         FILE* f;
@@ -140,41 +517,152 @@ struct MapData
         return rv;
     }
 
-    // returns the start of the tileset data or 0 if there is no tileset in the file
-    int GetTileDataStart(ifstream& fin)
+    // returns the start of the tile data, which is after the tileset bitmap if there is one
+    i32 GetTileDataStart(const u8* bytes, i32 len)
     {
-        int rv = 0;
+        i32 rv = 0;
 
-        u8 data[16];
+        // if the bitmap header exists, its size field says where it ends
+        if (len >= 6 && bytes[0] == 'B' && bytes[1] == 'M')
+            rv = (i32)GetU32(bytes + 2);
 
-        fin.read((char*)data, 2);
+        if (rv < 0 || rv > len)
+            c.log->FatalError("Map file tileset size (%d) is past the end of the file.", rv);
 
-        if (!fin)
-            c.log->FatalError("Error reading map file header.");
+        return rv;
+    }
 
-        // if the bitmap header exists
-        if (data[0] == 'B' && data[1] == 'M')
+    // only the occupied chunks can have solid tiles
+    void BuildCollisionMap()
+    {
+        const i32 CHUNK_TILES = TileMap::CHUNK_TILES;
+
+        collisionMap = unique_ptr<CollisionMap>(new CollisionMap());
+        collisionClear(collisionMap.get());
+
+        for (i32 cy = 0; cy < TileMap::CHUNKS; ++cy)
         {
-            fin.read((char*)data, 4);
+            for (i32 cx = 0; cx < TileMap::CHUNKS; ++cx)
+            {
+                const u8* chunk = theMap->GetChunk(cx, cy);
 
-            if (!fin)
-                c.log->FatalError("Error reading map file tile data start.");
+                for (i32 i = 0; chunk != nullptr && i < TileMap::CHUNK_BYTES; ++i)
+                {
+                    if (chunk[i] != 0)
+                        collisionSetTile(collisionMap.get(), cx * CHUNK_TILES + i % CHUNK_TILES,
+                                         cy * CHUNK_TILES + i / CHUNK_TILES, chunk[i]);
+                }
+            }
+        }
+    }
 
-            rv = GetU32(data);
+    // shade the radar pixels for chunk rows first, first + step, ... (rows of pixels are split
+    // between threads, each pixel is the count of solid tiles in its block)
+    void BuildRadarRows(i32 first, i32 step, u8* rgba)
+    {
+        const i32 CHUNK_TILES = TileMap::CHUNK_TILES;
+        const i32 BLOCKS_PER_CHUNK = CHUNK_TILES / RADAR_TILES_PER_PIXEL;
+        const i32 BLOCK_TILES = RADAR_TILES_PER_PIXEL * RADAR_TILES_PER_PIXEL;
+
+        for (i32 cy = first; cy < TileMap::CHUNKS; cy += step)
+        {
+            for (i32 cx = 0; cx < TileMap::CHUNKS; ++cx)
+            {
+                const u8* chunk = theMap->GetChunk(cx, cy);
+
+                for (i32 by = 0; by < BLOCKS_PER_CHUNK; ++by)
+                {
+                    for (i32 bx = 0; bx < BLOCKS_PER_CHUNK; ++bx)
+                    {
+                        i32 solid = 0;
+
+                        for (i32 ty = 0; chunk != nullptr && ty < RADAR_TILES_PER_PIXEL; ++ty)
+                        {
+                            const u8* row = chunk +
+                                            (by * RADAR_TILES_PER_PIXEL + ty) * CHUNK_TILES +
+                                            bx * RADAR_TILES_PER_PIXEL;
+
+                            for (i32 tx = 0; tx < RADAR_TILES_PER_PIXEL; ++tx)
+                                solid += collisionIsSolidTileId(row[tx]);
+                        }
+
+                        i32 px = cx * BLOCKS_PER_CHUNK + bx;
+                        i32 py = cy * BLOCKS_PER_CHUNK + by;
+                        u8* pixel = rgba + (py * RADAR_PIXELS + px) * 4;
+
+                        // dark blue background (not black, that's transparent), brighter with
+                        // more wall in the block
+                        pixel[0] = 0x10 + 0x8c * solid / BLOCK_TILES;
+                        pixel[1] = 0x10 + 0x98 * solid / BLOCK_TILES;
+                        pixel[2] = 0x18 + 0xa8 * solid / BLOCK_TILES;
+                        pixel[3] = 0xff;
+                    }
+                }
+            }
         }
+    }
 
-        return rv;
+    void BuildRadar()
+    {
+        vector<u8> rgba(RADAR_PIXELS * RADAR_PIXELS * 4);
+        vector<std::thread> threads;
+        i32 numThreads = std::thread::hardware_concurrency();
+
+        numThreads = max(1, min(numThreads, RADAR_MAX_THREADS));
+
+        for (i32 t = 1; t < numThreads; ++t)
+            threads.push_back(std::thread([this, t, numThreads, &rgba]()
+                                          { BuildRadarRows(t, numThreads, rgba.data()); }));
+
+        BuildRadarRows(0, numThreads, rgba.data());
+
+        for (std::thread& t : threads)
+            t.join();
+
+        radarImage = c.graphics->MakeImageFromPixels("radar", RADAR_PIXELS, RADAR_PIXELS,
+                                                     rgba.data());
     }
 
-    void ReadTile(ifstream& fin, TileStruct* t)
+    void DrawRadar(float alpha)
     {
-        u8 data[4];
-        fin.read((char*)data, sizeof(data));
+        u32 w = 0, h = 0;
+        c.graphics->GetScreenSize(&w, &h);
+
+        i32 left = w - RADAR_PIXELS - RADAR_MARGIN;
+        i32 top = h - RADAR_PIXELS - RADAR_MARGIN;
+        const i32 PIXELS_PER_RADAR_PIXEL = PIXELS_PER_TILE * RADAR_TILES_PER_PIXEL;
+
+        c.graphics->DrawImageFrame(radarImage, 0, left, top);
+
+        shared_ptr<Player> self = c.players->GetSelfPlayer(false);
+        c.players->GetPlayers(&radarPlayers);
+        radarTeamDots.clear();
+        radarEnemyDots.clear();
 
-        // little endian black magic
-        t->x = data[0] | ((data[1] & 0x0F) << 8);
-        t->y = ((data[1] & 0xF0) >> 4) | (data[2] << 4);
-        t->tile = data[3];
+        for (auto& p : radarPlayers)
+        {
+            if (p->ship == Ship_Spec || p == self)
+                continue;
+
+            SDL_Rect dot = {left + p->GetDrawXPixel(alpha) / PIXELS_PER_RADAR_PIXEL - 1,
+                            top + p->GetDrawYPixel(alpha) / PIXELS_PER_RADAR_PIXEL - 1, 2, 2};
+
+            if (self != nullptr && p->freq == self->freq)
+                radarTeamDots.push_back(dot);
+            else
+                radarEnemyDots.push_back(dot);
+        }
+
+        // self is a bit bigger
+        if (self != nullptr && self->ship != Ship_Spec)
+        {
+            SDL_Rect dot = {left + self->GetDrawXPixel(alpha) / PIXELS_PER_RADAR_PIXEL - 1,
+                            top + self->GetDrawYPixel(alpha) / PIXELS_PER_RADAR_PIXEL - 1, 3, 3};
+            radarTeamDots.push_back(dot);
+        }
+
+        c.graphics->DrawRects(radarTeamDots.data(), radarTeamDots.size(), Color_Yellow);
+        c.graphics->DrawRects(radarEnemyDots.data(), radarEnemyDots.size(), Color_Blue);
     }
 
     void SetMapPath(const char* path)
@@ -184,50 +672,35 @@ struct MapData
             // clear associated map data
             hasTileset = false;
             theMap = nullptr;
+            collisionMap = nullptr;
+            radarImage = nullptr;
             curTileset = nullptr;
         }
         else
         {
             // load it
-            ifstream fin(path, ios::binary);
+            u64 startCounter = SDL_GetPerformanceCounter();
+            MappedFile file;
 
-            if (fin.good())
+            if (file.Open(path))
             {
-                // find the start of the tile data
-                int startOfTileData = GetTileDataStart(fin);
-                bool hasTileset = startOfTileData != 0;
+                i32 startOfTileData = GetTileDataStart(file.bytes, file.len);
+                hasTileset = startOfTileData != 0;
 
-                fin.seekg(startOfTileData, ios_base::beg);
+                // a partial record at the end is ignored
+                theMap = unique_ptr<TileMap>(new TileMap());
 
-                int mapBytes = MAP_TILES_WIDTH * MAP_TILES_HEIGHT;
-                theMap = unique_ptr<u8[]>(new u8[mapBytes]);
+                if (!theMap->Build(file.bytes + startOfTileData, (file.len - startOfTileData) / 4))
+                    c.log->FatalError("Out of bounds tile coordinate in lvl file.");
 
-                for (int x = 0; x < MAP_TILES_WIDTH; ++x)
-                    for (int y = 0; y < MAP_TILES_HEIGHT; ++y)
-                        theMap[y * MAP_TILES_WIDTH + x] = 0;
-
-                while (!fin.eof())
-                {
-                    TileStruct t;
-
-                    ReadTile(fin, &t);
-
-                    if (!fin.eof())
-                    {
-                        if (t.x < MAP_TILES_WIDTH && t.y < MAP_TILES_HEIGHT)
-                            theMap[t.y * MAP_TILES_WIDTH + t.x] = t.tile;
-                        else
-                            c.log->FatalError("Out of bounds tile coordinate in lvl file.");
-                    }
-                }
-
-                fin.close();
+                BuildCollisionMap();
+                BuildRadar();
 
                 if (hasTileset)
                 {
-                    // prepend "../" to get out of the resources folder
-                    string tilesetPath = string("../") + path;
-                    curTileset = c.graphics->LoadImage(tilesetPath.c_str());
+                    // the bitmap is copied out of the mapped file and decoded in the background
+                    curTileset = c.graphics->LoadImageFromMemory(path, file.bytes,
+                                                                 startOfTileData, 19, 10);
                 }
                 else
                     curTileset = defaultTileset;
@@ -235,7 +708,10 @@ struct MapData
             else
                 c.log->FatalError("Error loading map from '%s'", path);
 
-            c.log->LogDrivel("Map successfully loaded from '%s'", path);
+            double ms = (SDL_GetPerformanceCounter() - startCounter) * 1000.0 /
+                        SDL_GetPerformanceFrequency();
+            c.log->LogDrivel("Map successfully loaded from '%s' in %.2f ms (%d of %d chunks used)",
+                             path, ms, theMap->numChunks, TileMap::CHUNKS * TileMap::CHUNKS);
         }
 
         // ok map is now loaded, we should set up the drawing of it, maybe use players to store
@@ -253,7 +729,11 @@ struct MapData
             ZlibDecompress(c, &((*compressedData)[0]), compressedData->size(), &decompressedLen);
 
         string dir = c.connection->GetZoneDir();
-        string savePath = dir + SanitizeString(receivedFilename->c_str());
+        string saveFilename = SanitizeString(receivedFilename->c_str());
+        string savePath = dir + saveFilename;
+
+        // the old file may be a link to a map store entry, so don't write through it
+        remove(savePath.c_str());
 
         FILE* f = fopen(savePath.c_str(), "wb");
 
@@ -265,16 +745,32 @@ struct MapData
 
         fclose(f);
 
+        u32 crc = crc32(crc32(0, Z_NULL, 0), data.get(), decompressedLen);
+        UpdateCrcIndex(dir, saveFilename, crc);
+
+        // share it with other zones
+        if (crc == downloadChecksum)
+        {
+            string storeDir = c.connection->GetMapStoreDir();
+            string storeFilename = GetStoreFilename(crc, downloadCompressedSize);
+
+            if (LinkOrCopy(savePath, storeDir + storeFilename))
+                UpdateCrcIndex(storeDir, storeFilename, crc);
+        }
+        else
+            c.log->LogError("Downloaded map '%s' has crc32 %08x, but the map info said %08x",
+                            savePath.c_str(), crc, downloadChecksum);
+
         c.log->LogDrivel("Save downloaded map to '%s'", savePath.c_str());
 
         c.map->SetMapPath(savePath.c_str());
     };
 
-    void DrawMap()
+    void DrawMap(float alpha)
     {
         shared_ptr<Player> p = c.players->GetSelfPlayer();
-        i32 playerX = p->GetXPixel();
-        i32 playerY = p->GetYPixel();
+        i32 playerX = p->GetDrawXPixel(alpha);
+        i32 playerY = p->GetDrawYPixel(alpha);
         u32 w = 0, h = 0;
 
         c.graphics->GetScreenSize(&w, &h);
@@ -290,24 +786,47 @@ struct MapData
         i32 drawOffsetX = w / 2 - playerX;
         i32 drawOffsetY = h / 2 - playerY;
 
-        for (i32 y = topTile; y < bottomTile; ++y)
-        {
-            if (y < 0 || y >= MAP_TILES_HEIGHT)
-                continue;
+        // clip to the map, the ranges are inclusive
+        topTile = max(topTile, 0);
+        leftTile = max(leftTile, 0);
+        bottomTile = min(bottomTile, TileMap::MAP_TILES) - 1;
+        rightTile = min(rightTile, TileMap::MAP_TILES) - 1;
 
-            for (i32 x = leftTile; x < rightTile; ++x)
+        const i32 SHIFT = TileMap::CHUNK_SHIFT;
+        const i32 CHUNK_TILES = TileMap::CHUNK_TILES;
+
+        for (i32 cy = topTile >> SHIFT; topTile <= bottomTile && cy <= bottomTile >> SHIFT; ++cy)
+        {
+            for (i32 cx = leftTile >> SHIFT; leftTile <= rightTile && cx <= rightTile >> SHIFT;
+                 ++cx)
             {
-                if (x < 0 || x >= MAP_TILES_WIDTH)
+                const u8* chunk = theMap->GetChunk(cx, cy);
+
+                if (chunk == nullptr)
                     continue;
 
-                u8 tile = theMap[y * MAP_TILES_WIDTH + x];
+                // the visible part of the chunk
+                i32 y1 = max(topTile, cy * CHUNK_TILES);
+                i32 y2 = min(bottomTile, cy * CHUNK_TILES + CHUNK_TILES - 1);
+                i32 x1 = max(leftTile, cx * CHUNK_TILES);
+                i32 x2 = min(rightTile, cx * CHUNK_TILES + CHUNK_TILES - 1);
 
-                if (tile > 0 && tile <= 190)  // over 162 is special tile?
+                for (i32 y = y1; y <= y2; ++y)
                 {
-                    i32 xpos = x * 16 + drawOffsetX;
-                    i32 ypos = y * 16 + drawOffsetY;
+                    const u8* row = chunk + (y - cy * CHUNK_TILES) * CHUNK_TILES;
 
-                    c.graphics->DrawImageFrame(curTileset, tile - 1, xpos, ypos);
+                    for (i32 x = x1; x <= x2; ++x)
+                    {
+                        u8 tile = row[x - cx * CHUNK_TILES];
+
+                        if (tile > 0 && tile <= 190)  // over 162 is special tile?
+                        {
+                            i32 xpos = x * 16 + drawOffsetX;
+                            i32 ypos = y * 16 + drawOffsetY;
+
+                            c.graphics->DrawImageFrame(curTileset, tile - 1, xpos, ypos);
+                        }
+                    }
                 }
             }
         }
@@ -329,8 +848,28 @@ void Map::SetMapPath(const char* path)
     data->SetMapPath(path);
 }
 
-void Map::DrawMap()
+u8 Map::GetTile(i32 x, i32 y)
 {
+    return data->theMap ? data->theMap->GetTile(x, y) : 0;
+}
+
+void Map::DrawRadar(float alpha)
+{
+    TRACE_ZONE("DrawRadar");
+
+    if (data->radarImage)
+        data->DrawRadar(alpha);
+}
+
+const CollisionMap* Map::GetCollisionMap()
+{
+    return data->collisionMap.get();
+}
+
+void Map::DrawMap(float alpha)
+{
+    TRACE_ZONE("DrawMap");
+
     if (data->theMap)
-        data->DrawMap();
+        data->DrawMap(alpha);
 }
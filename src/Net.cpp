@@ -2,9 +2,14 @@
 #include "Chat.h"
 #include "NetCoreHandlers.h"
 #include "Connection.h"
+#include "Trace.h"
 
-#include "SDL2/SDL_net.h"
 #include <list>
+#include <cstdio>
+
+// capture files start with this, followed by a u32 version
+static const char CAPTURE_MAGIC[4] = {'D', 'C', 'A', 'P'};
+static const u32 CAPTURE_VERSION = 1;
 
 struct NetData
 {
@@ -14,7 +19,7 @@ struct NetData
     Client& c;
     NetCoreHanders coreHandlers;
 
-    i32 maxTimeWithoutData = c.cfg->GetInt("Net", "Max Time Without Data", 10);
+    i32 maxTimeWithoutData = c.cfg->Values().netMaxTimeWithoutData;
 
     UDPsocket sock = nullptr;
     i32 channel = -1;
@@ -23,6 +28,14 @@ struct NetData
 
     vector<vector<u8>> packetQueue;
 
+    // packet capture (Net::Capture File), every datagram in and out with a timestamp
+    FILE* captureFile = nullptr;
+    u64 captureStartCounter = 0;
+    double captureCounterToUs = 0;
+
+    // replaying a capture, there's no socket and everything sent is discarded
+    bool replaying = false;
+
     multimap<string, std::function<void(const PacketInstance*)>> nameToFunctionMap;
     multimap<PacketType, std::function<void(const u8*, i32)>> rawPackedHandlers;
 
@@ -43,15 +56,59 @@ struct NetData
         AddPacketHandler("sync pong", coreHandlers.handleSyncPong);
         AddPacketHandler("sync request", coreHandlers.handleSyncRequest);
 
-        vector<i32> ignoreTypes = c.cfg->GetIntList("Packets", "Ignore Game Packets");
-
-        for (i32 type : ignoreTypes)
+        for (i32 type : c.cfg->Values().packetsIgnoreGamePackets)
             AddRawPacketHandler(make_pair(false, (u8)type), coreHandlers.ignoreRawPacket);
+
+        const string& capturePath = c.cfg->Values().netCaptureFile;
+
+        if (!capturePath.empty())
+            OpenCapture(capturePath.c_str());
     }
 
     ~NetData()
     {
         ResetConnectionResources();  // will close socket and free resources
+
+        if (captureFile != nullptr)
+            fclose(captureFile);
+    }
+
+    void OpenCapture(const char* path)
+    {
+        captureFile = fopen(path, "wb");
+
+        if (captureFile == nullptr)
+            c.log->LogError("Could not open packet capture file '%s'", path);
+        else
+        {
+            // big buffer, so capturing doesn't add a write call per packet
+            setvbuf(captureFile, nullptr, _IOFBF, 1 << 16);
+
+            u8 header[8];
+            memcpy(header, CAPTURE_MAGIC, 4);
+            PutU32(header + 4, CAPTURE_VERSION);
+            fwrite(header, 1, sizeof(header), captureFile);
+
+            captureStartCounter = SDL_GetPerformanceCounter();
+            captureCounterToUs = 1000000.0 / SDL_GetPerformanceFrequency();
+
+            c.log->LogInfo("Capturing packets to '%s'", path);
+        }
+    }
+
+    // record: u64 microseconds since the capture started, u8 direction, u16 length, data
+    void CapturePacket(CaptureDirection dir, const u8* data, i32 len)
+    {
+        u8 header[11];
+        u64 us = (u64)((SDL_GetPerformanceCounter() - captureStartCounter) * captureCounterToUs);
+
+        PutU32(header, (u32)us);
+        PutU32(header + 4, (u32)(us >> 32));
+        header[8] = dir;
+        PutU16(header + 9, (u16)len);
+
+        fwrite(header, 1, sizeof(header), captureFile);
+        fwrite(data, 1, len, captureFile);
     }
 
     void ResetConnectionResources()
@@ -88,9 +145,13 @@ struct NetData
 
         ResetConnectionResources();
 
-        sock = SDLNet_UDP_Open(0);
-
-        if (!sock)
+        if (replaying)
+        {
+            // no socket, only the reusable packet (which is how Net tells that it's connected)
+            packet = SDLNet_AllocPacket(MAX_BYTES_PER_PACKET);
+            rv = packet != nullptr;
+        }
+        else if ((sock = SDLNet_UDP_Open(0)) == nullptr)
             c.log->LogError("SDLNet_UDP_Open: %s\n", SDLNet_GetError());
         else
         {
@@ -141,6 +202,15 @@ struct NetData
             range.first->second(data, len);
     }
 
+    // zone names for packet dispatch, like "packet 0x28" or "core packet 0x03"
+    const char* TracePacketName(PacketType type)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%spacket 0x%02x", type.first ? "core " : "", type.second);
+
+        return TraceName(name);
+    }
+
     void PumpPacket(const u8* data, int len)
     {
         if (len < 1 || (data[0] == CORE_HEADER && len < 2))
@@ -160,6 +230,7 @@ struct NetData
                 type.second = data[0];
             }
 
+            TRACE_ZONE(traceEnabled.load() ? TracePacketName(type) : nullptr);
             ProcessRawTypedPacket(type, data, len);
         }
     }
@@ -188,6 +259,12 @@ struct NetData
             // DumpPacket("RECV", (u8*)packet->data, packet->len);
 
             lastData = now;
+            ++coreHandlers.stats.packetsReceived;
+            coreHandlers.stats.bytesReceived += packet->len;
+
+            if (captureFile != nullptr)
+                CapturePacket(Capture_Received, packet->data, packet->len);
+
             PumpPacket(packet->data, packet->len);
         }
 
@@ -235,12 +312,16 @@ struct NetData
 
     void SendBinaryPacket(UDPpacket* p)
     {
-        // statsSentRecently += p->len;
-        // statsSentTotal += p->len;
+        ++coreHandlers.stats.packetsSent;
+        coreHandlers.stats.bytesSent += p->len;
 
         // DumpPacket("SEND", (u8*)p->data, p->len);
 
-        if (!SDLNet_UDP_Send(sock, channel, p))
+        if (captureFile != nullptr)
+            CapturePacket(Capture_Sent, p->data, p->len);
+
+        // when replaying there's nowhere to send it
+        if (!replaying && !SDLNet_UDP_Send(sock, channel, p))
             c.log->LogError("SDLNet_UDP_Send: %s\n", SDLNet_GetError());
     }
 
@@ -340,6 +421,8 @@ struct NetData
 
         if (store.templateName != "temp")
         {
+            TRACE_ZONE(traceEnabled.load() ? TraceName(store.templateName) : nullptr);
+
             // lookup the template handler
             pair<multimap<string, std::function<void(const PacketInstance*)>>::iterator,
                  multimap<string, std::function<void(const PacketInstance*)>>::iterator> range =
@@ -397,7 +480,9 @@ void Net::ReceivePackets(i32 ms)
 
 void Net::SendPackets(i32 ms)
 {
-    if (data->packet != nullptr)  // if we're connected
+    // when replaying, acks for our reliable packets only arrive if the recording has them, so
+    // don't resend (and eventually disconnect) while waiting for them
+    if (data->packet != nullptr && !data->replaying)  // if we're connected
         data->coreHandlers.ResendReliablePackets(ms, &data->packetQueue);
 
     if (data->packet != nullptr)  // if we're still connected (reliable resend can disconnect)
@@ -409,11 +494,21 @@ void Net::AddPacketHandler(const char* name, std::function<void(const PacketInst
     data->AddPacketHandler(name, func);
 }
 
+void Net::AddRawPacketHandler(PacketType type, std::function<void(const u8*, i32)> func)
+{
+    data->AddRawPacketHandler(type, func);
+}
+
 void Net::SendPacket(PacketInstance* packet)
 {
     data->SendPacket(packet, false);
 }
 
+void Net::SendRawPacket(const u8* bytes, i32 len)
+{
+    data->packetQueue.push_back(vector<u8>(bytes, bytes + len));
+}
+
 void Net::SendReliablePacket(PacketInstance* packet)
 {
     data->SendPacket(packet, true);
@@ -434,3 +529,97 @@ const ArenaSettings* Net::GetArenaSettings()
 {
     return &data->coreHandlers.arenaSettings;
 }
+
+const NetStats* Net::GetStats()
+{
+    data->coreHandlers.stats.reliableQueued = data->coreHandlers.relPackets.size();
+
+    return &data->coreHandlers.stats;
+}
+
+UDPsocket Net::GetSocket()
+{
+    return data->sock;
+}
+
+void Net::StartReplay()
+{
+    data->replaying = true;
+}
+
+bool ReadCaptureHeader(FILE* f)
+{
+    u8 header[8];
+    bool rv = false;
+
+    if (fread(header, 1, sizeof(header), f) == sizeof(header))
+        rv = memcmp(header, CAPTURE_MAGIC, 4) == 0 && GetU32(header + 4) == CAPTURE_VERSION;
+
+    return rv;
+}
+
+bool ReadCaptureRecord(FILE* f, CaptureRecord* store)
+{
+    u8 header[11];
+    bool rv = false;
+
+    if (fread(header, 1, sizeof(header), f) == sizeof(header))
+    {
+        store->microseconds = GetU32(header) | ((u64)GetU32(header + 4) << 32);
+        store->direction = (CaptureDirection)header[8];
+        store->data.resize(GetU16(header + 9));
+
+        rv = fread(store->data.data(), 1, store->data.size(), f) == store->data.size();
+    }
+
+    return rv;
+}
+
+void NetStats::RecordRtt(i32 ms)
+{
+    if (ms < 0)
+        ms = 0;
+    else if (ms >= RTT_BUCKETS)
+        ms = RTT_BUCKETS - 1;
+
+    ++rttHistogram[ms];
+    ++rttSamples;
+}
+
+i32 NetStats::RttPercentile(double percent) const
+{
+    i32 rv = -1;
+
+    if (rttSamples > 0)
+    {
+        u64 target = (u64)(rttSamples * percent / 100.0);
+        u64 count = 0;
+
+        for (i32 ms = 0; ms < RTT_BUCKETS; ++ms)
+        {
+            count += rttHistogram[ms];
+
+            if (count > target || ms == RTT_BUCKETS - 1)
+            {
+                rv = ms;
+                break;
+            }
+        }
+    }
+
+    return rv;
+}
+
+void NetStats::Add(const NetStats* other)
+{
+    packetsSent += other->packetsSent;
+    packetsReceived += other->packetsReceived;
+    bytesSent += other->bytesSent;
+    bytesReceived += other->bytesReceived;
+    reliableSent += other->reliableSent;
+    reliableResent += other->reliableResent;
+    rttSamples += other->rttSamples;
+
+    for (i32 i = 0; i < RTT_BUCKETS; ++i)
+        rttHistogram[i] += other->rttHistogram[i];
+}
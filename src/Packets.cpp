@@ -72,12 +72,14 @@ struct PacketTemplate
 {
     u8 type;
     bool isCore;
+    u16 length;  // total length including the header, 0 if it has variable length fields
     vector<TemplateEntry> chunks;
 
     PacketTemplate()
     {
         isCore = false;
         type = 0x00;
+        length = 0;
     }
 };
 
@@ -87,6 +89,7 @@ struct PacketsData
 
     Client& c;
 
+    map<string, PacketTemplate> compiledTemplates;  // everything in the config, by name
     map<string, PacketTemplate> incomingOrCoreNameToTemplateMap;
     map<string, PacketTemplate> outgoingNameToTemplateMap;
 
@@ -325,19 +328,25 @@ struct PacketsData
 
     void LogPacketError(const char* header, const u8* data, int len)
     {
+        // the log copies at most a couple hundred bytes of text, only dump the start
+        const int MAX_DUMP_BYTES = 48;
+
         string msg = header;
         msg += " (len = " + to_string(len) + " bytes):";
-        for (int x = 0; x < len; ++x)
+        for (int x = 0; x < len && x < MAX_DUMP_BYTES; ++x)
         {
             char buf[8];
             snprintf(buf, sizeof(buf), " %02x", data[x]);
             msg += buf;
         }
 
+        if (len > MAX_DUMP_BYTES)
+            msg += " ...";
+
         c.log->LogError("%s", msg.c_str());
     }
 
-    // loads it if necessary
+    // the templates get registered as incoming or outgoing on first use
     PacketTemplate* GetTemplate(const char* templateName, bool outgoingPacket)
     {
         PacketTemplate* rv = nullptr;
@@ -354,122 +363,193 @@ struct PacketsData
         }
 
         if (!found)
-        {  // load it
-            const char* cat = "Packets";
-            char buf[256];
-            u16 len = 1;
+        {
+            auto compiled = compiledTemplates.find(templateName);
 
-            snprintf(buf, sizeof(buf), "%s Field Count", templateName);
-            i32 count = c.cfg->GetInt(cat, buf, -1, [](i32 val)
-                                      {
-                                          return val >= 0;
-                                      });
+            if (compiled != compiledTemplates.end())
+            {
+                const PacketTemplate& pt = compiled->second;
 
-            snprintf(buf, sizeof(buf), "%s Type", templateName);
-            i32 packetId = c.cfg->GetInt(cat, buf, -1, [](i32 val)
-                                         {
-                                             return val >= 1 && val <= 255;
-                                         });
+                if (pt.isCore || !outgoingPacket)
+                {
+                    AddIncomingPacketId(pt.isCore ? pt.type : pt.type << 8, pt.length,
+                                        templateName);
 
-            bool core = false;
+                    incomingOrCoreNameToTemplateMap[templateName] = pt;
+                    rv = &incomingOrCoreNameToTemplateMap[templateName];
+                }
+                else
+                {
+                    outgoingNameToTemplateMap[templateName] = pt;
+                    rv = &outgoingNameToTemplateMap[templateName];
+                }
+            }
+        }
+        else
+            rv = &i->second;
 
-            snprintf(buf, sizeof(buf), "%s iscore", templateName);
-            core = c.cfg->GetInt(cat, buf, 0) != 0;
+        if (rv == nullptr)
+            c.log->FatalError("GetTemplate() could not load packet template for '%s'",
+                              templateName);
 
-            if (core)
-                ++len;
+        return rv;
+    }
 
-            PacketTemplate pt;
+    // parse every template in the [Packets] section of the config at once, so that using a
+    // template never has to look anything up in the config
+    void CompileTemplates()
+    {
+        const string FIELD_COUNT_SUFFIX = " field count";
+        const map<string, string>* section = c.cfg->GetSection("Packets");
 
-            // for each field
-            int x;
-            for (x = 0; x < count; ++x)
+        if (section == nullptr)
+            c.log->LogError("Config has no [Packets] section, no packet templates are defined");
+        else
+        {
+            for (auto& it : *section)
             {
-                snprintf(buf, sizeof(buf), "%s Field %i Name", templateName, x);
-                const char* fieldName = c.cfg->GetStringNoDefault(cat, buf);
+                const string& key = it.first;
 
-                if (fieldName == nullptr)
+                if (key.length() > FIELD_COUNT_SUFFIX.length() &&
+                    key.compare(key.length() - FIELD_COUNT_SUFFIX.length(),
+                                FIELD_COUNT_SUFFIX.length(), FIELD_COUNT_SUFFIX) == 0)
                 {
-                    c.log->LogError("%s::%s is invalid or undefined", cat, buf);
-                    break;
+                    string name = key.substr(0, key.length() - FIELD_COUNT_SUFFIX.length());
+                    PacketTemplate pt;
+
+                    if (CompileTemplate(section, name, &pt))
+                        compiledTemplates[name] = pt;
                 }
+            }
+        }
+    }
 
-                snprintf(buf, sizeof(buf), "%s Field %i Type", templateName, x);
-                const char* fieldType = c.cfg->GetStringNoDefault(cat, buf);
+    // returns false (and logs the error) if the template is malformed
+    bool CompileTemplate(const map<string, string>* section, const string& name,
+                         PacketTemplate* store)
+    {
+        auto getString = [section, &name](const string& suffix) -> const char*
+        {
+            auto it = section->find(name + suffix);
 
-                if (fieldType == nullptr)
-                {
-                    c.log->LogError("%s::%s is invalid", cat, buf);
-                    break;
-                }
+            return it == section->end() ? nullptr : it->second.c_str();
+        };
 
-                FieldType ft = FieldTypeStringToFieldType(fieldType);  // will report errors
-                i32 fieldLength = 0;
-                snprintf(buf, sizeof(buf), "%s Field %i Length", templateName, x);
+        // returns false if it's missing or not a number
+        auto getInt = [&getString](const string& suffix, i32* store) -> bool
+        {
+            const char* val = getString(suffix);
+            bool rv = false;
 
-                if (ft == FT_NTSTRING || ft == FT_RAW)
-                {
-                    len = 0;  // these types don't allow for multiple handlers/type
+            if (val != nullptr)
+            {
+                char* end;
+                *store = strtol(val, &end, 0);
+                rv = *end == '\0';
+            }
 
-                    if (c.cfg->GetStringNoDefault(cat, buf) != nullptr)
-                    {
-                        c.log->LogError("%s::%s shoudln't be defined (type is %s)", cat, buf,
-                                        fieldType);
-                        break;
-                    }
-                }
-                else
-                {
-                    fieldLength = c.cfg->GetInt(cat, buf, -1);
-                    len += fieldLength;
+            return rv;
+        };
 
-                    if (ft == FT_STRING && fieldLength <= 0)
-                    {
-                        c.log->LogError("%s::%s is invalid", cat, buf);
-                        break;
-                    }
-                    else if (ft == FT_INT &&
-                             !(fieldLength == 1 || fieldLength == 2 || fieldLength == 4))
-                    {
-                        c.log->LogError("%s::%s is invalid", cat, buf);
-                        break;
-                    }
-                }
+        bool rv = true;
+        i32 count = -1, packetId = -1, core = 0;
+        u16 len = 1;
+
+        if (!getInt(" field count", &count) || count < 0)
+        {
+            c.log->LogError("Packets::%s field count is invalid", name.c_str());
+            rv = false;
+        }
+        else if (!getInt(" type", &packetId) || packetId < 1 || packetId > 255)
+        {
+            c.log->LogError("Packets::%s type is invalid or undefined", name.c_str());
+            rv = false;
+        }
+        else if (getString(" iscore") != nullptr && !getInt(" iscore", &core))
+        {
+            c.log->LogError("Packets::%s iscore is invalid", name.c_str());
+            rv = false;
+        }
 
-                TemplateEntry te;
+        if (core != 0)
+            ++len;
 
-                te.name = fieldName;
-                te.type = ft;
-                te.length = fieldLength;
+        // for each field
+        for (i32 x = 0; rv && x < count; ++x)
+        {
+            string field = " field " + to_string(x);
+            const char* fieldName = getString(field + " name");
+            const char* fieldType = getString(field + " type");
 
-                pt.chunks.push_back(te);
+            if (fieldName == nullptr)
+            {
+                c.log->LogError("Packets::%s%s name is invalid or undefined", name.c_str(),
+                                field.c_str());
+                rv = false;
+                break;
+            }
+
+            if (fieldType == nullptr)
+            {
+                c.log->LogError("Packets::%s%s type is invalid", name.c_str(), field.c_str());
+                rv = false;
+                break;
             }
 
-            if (x == count)  // there were no errors
+            FieldType ft = FieldTypeStringToFieldType(fieldType);  // will report errors
+            i32 fieldLength = 0;
+
+            if (ft == FT_NTSTRING || ft == FT_RAW)
             {
-                pt.isCore = core;
-                pt.type = packetId;
+                len = 0;  // these types don't allow for multiple handlers/type
 
-                if (core || !outgoingPacket)
+                if (getString(field + " length") != nullptr)
                 {
-                    AddIncomingPacketId(core ? packetId : packetId << 8, len, templateName);
+                    c.log->LogError("Packets::%s%s length shoudln't be defined (type is %s)",
+                                    name.c_str(), field.c_str(), fieldType);
+                    rv = false;
+                    break;
+                }
+            }
+            else
+            {
+                if (!getInt(field + " length", &fieldLength))
+                    fieldLength = -1;
 
-                    incomingOrCoreNameToTemplateMap[templateName] = pt;
-                    rv = &incomingOrCoreNameToTemplateMap[templateName];
+                len += fieldLength;
+
+                if (ft == FT_STRING && fieldLength <= 0)
+                {
+                    c.log->LogError("Packets::%s%s length is invalid", name.c_str(),
+                                    field.c_str());
+                    rv = false;
+                    break;
                 }
-                else
+                else if (ft == FT_INT &&
+                         !(fieldLength == 1 || fieldLength == 2 || fieldLength == 4))
                 {
-                    outgoingNameToTemplateMap[templateName] = pt;
-                    rv = &outgoingNameToTemplateMap[templateName];
+                    c.log->LogError("Packets::%s%s length is invalid", name.c_str(),
+                                    field.c_str());
+                    rv = false;
+                    break;
                 }
             }
+
+            TemplateEntry te;
+
+            te.name = fieldName;
+            te.type = ft;
+            te.length = fieldLength;
+
+            store->chunks.push_back(te);
         }
-        else
-            rv = &i->second;
 
-        if (rv == nullptr)
-            c.log->FatalError("GetTemplate() could not load packet template for '%s'",
-                              templateName);
+        if (rv)
+        {
+            store->isCore = core != 0;
+            store->type = packetId;
+            store->length = len;
+        }
 
         return rv;
     }
@@ -708,6 +788,7 @@ struct PacketsData
 
 Packets::Packets(Client& c) : Module(c), data(make_shared<PacketsData>(c))
 {
+    data->CompileTemplates();
 }
 
 Packets::~Packets()
@@ -734,6 +815,15 @@ void Packets::PacketTemplateToRaw(PacketInstance* packet, bool reliable, vector<
     data->PacketTemplateToRaw(packet, reliable, rawData);
 }
 
+void Packets::GetLoadedTemplateNames(vector<string>* incoming, vector<string>* outgoing)
+{
+    for (auto& it : data->incomingOrCoreNameToTemplateMap)
+        incoming->push_back(it.first);
+
+    for (auto& it : data->outgoingNameToTemplateMap)
+        outgoing->push_back(it.first);
+}
+
 i32 PacketInstance::GetIntValue(const char* type) const
 {
     i32 rv = 0;
@@ -0,0 +1,246 @@
+#include "PerfOverlay.h"
+#include "Graphics.h"
+#include "Timers.h"
+#include "Net.h"
+#include <deque>
+
+static const u32 PERF_WINDOW_MS = 1000;  // the rolling window everything is shown over
+static const i32 PERF_REFRESH_MS = 250;  // how often the text is rebuilt while visible
+static const i32 FRAME_BUCKETS = 1000;   // 0.1 ms each, the last one holds everything above
+static const double FRAME_BUCKET_MS = 0.1;
+
+struct FrameSample
+{
+    u32 ticks;
+    i32 bucket;
+    i32 steps;
+    u64 draws;
+};
+
+struct NetSample
+{
+    u32 ticks;
+    u64 packetsSent;
+    u64 packetsReceived;
+    u64 bytesSent;
+    u64 bytesReceived;
+    u64 reliableResent;
+    u64 rttSamples;
+    u32 rttHistogram[NetStats::RTT_BUCKETS];  // totals, so two samples give the rtts between them
+};
+
+struct PerfOverlayData
+{
+    PerfOverlayData(Client& client) : c(client) {}
+    Client& c;
+
+    bool visible = false;
+    shared_ptr<Timer> refreshTimer;
+    vector<shared_ptr<DrawnText>> lines;
+
+    // frames in the window, and a histogram of their times
+    deque<FrameSample> frames;
+    u32 frameHistogram[FRAME_BUCKETS] = {};
+    i32 maxBucket = 0;  // over the window, recomputed when the max leaves it
+    u64 lastDrawCount = 0;
+
+    // network counters at each step in the window
+    deque<NetSample> netSamples;
+
+    void DropOldFrames(u32 now);
+    double FramePercentile(double percent);
+    void Refresh();
+    void AddLine(const char* text);
+};
+
+void PerfOverlayData::DropOldFrames(u32 now)
+{
+    bool droppedMax = false;
+
+    while (!frames.empty() && now - frames.front().ticks > PERF_WINDOW_MS)
+    {
+        if (frames.front().bucket == maxBucket)
+            droppedMax = true;
+
+        --frameHistogram[frames.front().bucket];
+        frames.pop_front();
+    }
+
+    if (droppedMax)
+    {
+        maxBucket = 0;
+
+        for (const FrameSample& f : frames)
+            maxBucket = max(maxBucket, f.bucket);
+    }
+}
+
+double PerfOverlayData::FramePercentile(double percent)
+{
+    double rv = 0;
+    u64 target = (u64)(frames.size() * percent / 100.0);
+    u64 count = 0;
+
+    for (i32 b = 0; b < FRAME_BUCKETS; ++b)
+    {
+        count += frameHistogram[b];
+
+        if (count > target)
+        {
+            rv = b * FRAME_BUCKET_MS;
+            break;
+        }
+    }
+
+    return rv;
+}
+
+void PerfOverlayData::AddLine(const char* text)
+{
+    i32 lineHeight = c.graphics->GetFontHeight();
+
+    shared_ptr<DrawnText> line = c.graphics->MakeDrawnText(Layer_TopMost, Color_Yellow, text);
+    line->SetPosition(10, 40 + lineHeight * (i32)lines.size());
+
+    lines.push_back(line);
+}
+
+void PerfOverlayData::Refresh()
+{
+    char buf[160];
+    u32 now = SDL_GetTicks();
+
+    DropOldFrames(now);
+    lines.clear();
+
+    i32 steps = 0;
+    u64 draws = 0;
+
+    for (const FrameSample& f : frames)
+    {
+        steps += f.steps;
+        draws += f.draws;
+    }
+
+    i32 numFrames = max((i32)frames.size(), 1);
+
+    snprintf(buf, sizeof(buf), "frame ms: p50 %.1f  p99 %.1f  max %.1f  (%d frames)",
+             FramePercentile(50), FramePercentile(99), maxBucket * FRAME_BUCKET_MS,
+             (i32)frames.size());
+    AddLine(buf);
+
+    snprintf(buf, sizeof(buf), "per frame: %.2f steps  %.0f draws", steps / (double)numFrames,
+             draws / (double)numFrames);
+    AddLine(buf);
+
+    while (!netSamples.empty() && now - netSamples.front().ticks > PERF_WINDOW_MS)
+        netSamples.pop_front();
+
+    const NetStats* stats = c.net->GetStats();
+
+    if (netSamples.size() >= 2)
+    {
+        const NetSample& first = netSamples.front();
+        const NetSample& last = netSamples.back();
+        double seconds = max(last.ticks - first.ticks, 1u) / 1000.0;
+
+        snprintf(buf, sizeof(buf), "in: %.0f pkt/s  %.1f KB/s   out: %.0f pkt/s  %.1f KB/s",
+                 (last.packetsReceived - first.packetsReceived) / seconds,
+                 (last.bytesReceived - first.bytesReceived) / seconds / 1024.0,
+                 (last.packetsSent - first.packetsSent) / seconds,
+                 (last.bytesSent - first.bytesSent) / seconds / 1024.0);
+        AddLine(buf);
+
+        snprintf(buf, sizeof(buf), "reliable: %u queued  %.0f resent/s",
+                 (unsigned)stats->reliableQueued,
+                 (last.reliableResent - first.reliableResent) / seconds);
+        AddLine(buf);
+    }
+
+    // reliable round trips acked in the window
+    char rttText[32] = "-";
+
+    if (netSamples.size() >= 2)
+    {
+        const NetSample& first = netSamples.front();
+        const NetSample& last = netSamples.back();
+        NetStats window;
+
+        for (i32 i = 0; i < NetStats::RTT_BUCKETS; ++i)
+            window.rttHistogram[i] = last.rttHistogram[i] - first.rttHistogram[i];
+
+        window.rttSamples = last.rttSamples - first.rttSamples;
+
+        if (window.rttSamples > 0)
+            snprintf(rttText, sizeof(rttText), "%d ms", window.RttPercentile(50));
+    }
+
+    snprintf(buf, sizeof(buf), "ping: %d ms (reliable p50 %s)  server time offset: %d cs",
+             stats->syncRttMs, rttText, stats->serverTimeOffset);
+    AddLine(buf);
+}
+
+PerfOverlay::PerfOverlay(Client& c) : data(make_shared<PerfOverlayData>(c))
+{
+}
+
+void PerfOverlay::RecordFrame(double frameMs, i32 steps)
+{
+    u32 now = SDL_GetTicks();
+    i32 bucket = min((i32)(frameMs / FRAME_BUCKET_MS), FRAME_BUCKETS - 1);
+
+    u64 frameCount = 0, drawCount = 0;
+    data->c.graphics->GetDrawCounts(&frameCount, &drawCount);
+
+    FrameSample f = {now, bucket, steps, drawCount - data->lastDrawCount};
+    data->lastDrawCount = drawCount;
+
+    data->frames.push_back(f);
+    ++data->frameHistogram[bucket];
+    data->maxBucket = max(data->maxBucket, bucket);
+
+    data->DropOldFrames(now);
+}
+
+void PerfOverlay::RecordStep()
+{
+    u32 now = SDL_GetTicks();
+    const NetStats* stats = data->c.net->GetStats();
+    data->netSamples.emplace_back();
+    NetSample& s = data->netSamples.back();
+
+    s.ticks = now;
+    s.packetsSent = stats->packetsSent;
+    s.packetsReceived = stats->packetsReceived;
+    s.bytesSent = stats->bytesSent;
+    s.bytesReceived = stats->bytesReceived;
+    s.reliableResent = stats->reliableResent;
+    s.rttSamples = stats->rttSamples;
+    memcpy(s.rttHistogram, stats->rttHistogram, sizeof(s.rttHistogram));
+
+    while (now - data->netSamples.front().ticks > PERF_WINDOW_MS)
+        data->netSamples.pop_front();
+}
+
+void PerfOverlay::SetVisible(bool vis)
+{
+    data->visible = vis;
+
+    if (vis)
+    {
+        data->Refresh();
+        PerfOverlayData* d = data.get();
+        data->refreshTimer = data->c.timers->PeriodicTimer("perf_overlay_timer", PERF_REFRESH_MS,
+                                                           [d]() { d->Refresh(); });
+    }
+    else
+    {
+        data->refreshTimer = nullptr;
+        data->lines.clear();
+    }
+}
+
+bool PerfOverlay::IsVisible()
+{
+    return data->visible;
+}
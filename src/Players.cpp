@@ -4,16 +4,33 @@
 #include "Ships.h"
 #include <map>
 #include <set>
+#include <tuple>
 using namespace std;
 
+// one line in the on-screen player list, the texture is only re-rendered when the label changes
+struct RosterEntry
+{
+    string label;
+    i32 group = 0;  // 0 = self, 1 = teammate, 2 = enemy
+    i32 row = -1;   // row it's currently positioned at, -1 = not positioned yet
+    shared_ptr<DrawnText> text;
+};
+
+// roster sort order: group, then label alphabetically, then pid to break ties
+typedef tuple<i32, string, i32> RosterKey;
+
 struct PlayersModuleData
 {
+    const i32 ROSTER_X = 10;
+    const i32 ROSTER_Y = 35;
+
     Client& c;
 
     shared_ptr<Player> selfData = make_shared<Player>();
     map<i32, shared_ptr<Player>> idToPlayerMap;
 
-    vector<shared_ptr<DrawnText>> displayedNames;
+    map<i32, RosterEntry> roster;  // pid -> displayed entry
+    set<RosterKey> rosterOrder;
 
     map<ShipType, string> SHIP_NAMES = {
         {Ship_Warbird, "Warbird"},
@@ -31,75 +48,114 @@ struct PlayersModuleData
 
     void UpdatePlayerList()
     {
-        char buf[128];
+        RosterUpdate(selfData, false);
+
+        for (auto i : idToPlayerMap)
+            RosterUpdate(i.second, false);
 
-        // first add the player
-        snprintf(buf, sizeof(buf), "%s [%s] (%i)", selfData->name.c_str(),
-                 SHIP_NAMES[selfData->ship].c_str(), selfData->freq);
-        string selfName = buf;
+        LayoutRoster();
+    }
 
-        // then add all his teammates alphabetically
-        set<string> teammates;
+    // add or refresh a single player's roster entry
+    void RosterUpdate(shared_ptr<Player> p, bool layout = true)
+    {
+        char buf[128];
+        i32 group = 0;
 
-        for (auto i : idToPlayerMap)
+        if (p == selfData)
         {
-            if (i.second->pid == selfData->pid)
-                continue;
-
-            if (i.second->freq != selfData->freq)
-                continue;
+            snprintf(buf, sizeof(buf), "%s [%s] (%i)", p->name.c_str(),
+                     SHIP_NAMES[p->ship].c_str(), p->freq);
+        }
+        else
+        {
+            // teammates are listed before everyone else
+            group = p->freq == selfData->freq ? 1 : 2;
 
-            snprintf(buf, sizeof(buf), "%s [%s]", i.second->name.c_str(),
-                     SHIP_NAMES[i.second->ship].c_str());
-            teammates.insert(buf);
+            snprintf(buf, sizeof(buf), "%s [%s]", p->name.c_str(), SHIP_NAMES[p->ship].c_str());
         }
 
-        // then add everyone else alphabetically
-        set<string> enemies;
+        auto it = roster.find(p->pid);
 
-        for (auto i : idToPlayerMap)
-        {
-            if (i.second->freq == selfData->freq)
-                continue;
+        if (it == roster.end())
+            it = roster.insert(make_pair(p->pid, RosterEntry())).first;
+        else if (it->second.label == buf && it->second.group == group)
+            return;  // nothing changed
+        else
+            rosterOrder.erase(RosterKey(it->second.group, it->second.label, p->pid));
+
+        RosterEntry& e = it->second;
 
-            snprintf(buf, sizeof(buf), "%s [%s]", i.second->name.c_str(),
-                     SHIP_NAMES[i.second->ship].c_str());
-            enemies.insert(buf);
+        if (e.label != buf || !e.text)
+        {
+            e.label = buf;
+            e.text = c.graphics->MakeDrawnText(Layer_Gauges, Color_Yellow, buf);
+            e.row = -1;
         }
 
-        // make the DrawnText objects
-        i32 x = 10;
-        i32 y = 35;
+        e.group = group;
+        rosterOrder.insert(RosterKey(e.group, e.label, p->pid));
 
-        displayedNames.clear();
+        if (layout)
+            LayoutRoster();
+    }
 
-        shared_ptr<DrawnText> text =
-            c.graphics->MakeDrawnText(Layer_Gauges, Color_Yellow, selfName.c_str());
-        text->SetPosition(x, y);
-        y += c.graphics->GetFontHeight();
-        displayedNames.push_back(text);
+    void RosterRemove(i32 pid)
+    {
+        auto it = roster.find(pid);
 
-        for (const string& s : teammates)
+        if (it != roster.end())
         {
-            text = c.graphics->MakeDrawnText(Layer_Gauges, Color_Yellow, s.c_str());
-            text->SetPosition(x, y);
-            y += c.graphics->GetFontHeight();
-            displayedNames.push_back(text);
+            rosterOrder.erase(RosterKey(it->second.group, it->second.label, pid));
+            roster.erase(it);
+
+            LayoutRoster();
         }
+    }
 
-        for (const string& s : enemies)
+    // our own freq changed, so who counts as a teammate changed (labels stay the same)
+    void RosterRegroup()
+    {
+        for (auto i : idToPlayerMap)
         {
-            text = c.graphics->MakeDrawnText(Layer_Gauges, Color_Yellow, s.c_str());
-            text->SetPosition(x, y);
-            y += c.graphics->GetFontHeight();
-            displayedNames.push_back(text);
+            if (i.second != selfData)
+                RosterUpdate(i.second, false);
+        }
+
+        LayoutRoster();
+    }
+
+    // only entries whose row changed get moved
+    void LayoutRoster()
+    {
+        i32 row = 0;
+        i32 fontHeight = c.graphics->GetFontHeight();
+
+        for (const RosterKey& k : rosterOrder)
+        {
+            RosterEntry& e = roster[get<2>(k)];
+
+            if (e.row != row)
+            {
+                e.row = row;
+                e.text->SetPosition(ROSTER_X, ROSTER_Y + row * fontHeight);
+            }
+
+            ++row;
         }
     }
 
     std::function<void(const PacketInstance*)> handlePidChange = [this](const PacketInstance* pi)
     {
+        i32 oldPid = selfData->pid;
         selfData->pid = pi->GetIntValue("pid");
 
+        if (roster.find(oldPid) != roster.end())
+        {
+            RosterRemove(oldPid);
+            RosterUpdate(selfData);
+        }
+
         c.log->LogDrivel("Got Self PID change to %i", selfData->pid);
     };
 
@@ -108,7 +164,7 @@ struct PlayersModuleData
         i32 pid = pi->GetIntValue("pid");
 
         idToPlayerMap.erase(pid);
-        c.players->UpdatePlayerList();
+        RosterRemove(pid);
 
         c.log->LogDrivel("Player Left (pid=%i)", pid);
     };
@@ -138,7 +194,10 @@ struct PlayersModuleData
 
         idToPlayerMap[player->pid] = player;
 
-        c.players->UpdatePlayerList();
+        if (player == selfData)
+            RosterRegroup();
+
+        RosterUpdate(player);
 
         if (player == selfData)
             c.ships->ShipChanged(ship);  // handle an initial ship changed event
@@ -159,7 +218,10 @@ struct PlayersModuleData
         {
             it->second->freq = freq;
 
-            c.players->UpdatePlayerList();
+            if (it->second == selfData)
+                RosterRegroup();
+
+            RosterUpdate(it->second);
 
             c.log->LogDrivel("Freq Change to %i (%s)", freq, it->second->name.c_str());
         }
@@ -187,7 +249,10 @@ struct PlayersModuleData
             player->freq = freq;
             player->ship = ship;
 
-            c.players->UpdatePlayerList();
+            if (player == selfData)
+                RosterRegroup();
+
+            RosterUpdate(player);
 
             if (player == selfData)
             {
@@ -236,11 +301,37 @@ shared_ptr<Player> Players::GetSelfPlayer(bool logErrors)
     return data->selfData;
 }
 
+void Players::GetPlayers(vector<shared_ptr<Player>>* store)
+{
+    store->clear();
+
+    for (auto& i : data->idToPlayerMap)
+        store->push_back(i.second);
+}
+
 void Players::UpdatePlayerList()
 {
     data->UpdatePlayerList();
 }
 
+void Players::SaveInterpolationState()
+{
+    data->selfData->prevPhysics = data->selfData->physics;
+
+    for (auto i : data->idToPlayerMap)
+        i.second->prevPhysics = i.second->physics;
+}
+
+i32 Player::GetDrawXPixel(float alpha)
+{
+    return (prevPhysics.x + (physics.x - prevPhysics.x) * alpha + drawOffsetX) / 10000;
+}
+
+i32 Player::GetDrawYPixel(float alpha)
+{
+    return (prevPhysics.y + (physics.y - prevPhysics.y) * alpha + drawOffsetY) / 10000;
+}
+
 i32 Player::GetXPixel()
 {
     return physics.x / 10000;
@@ -258,6 +349,9 @@ void Player::SetPixel(i32 x, i32 y)
 {
     physics.x = 10000 * x;
     physics.y = 10000 * y;
+
+    // teleports shouldn't be interpolated
+    prevPhysics = physics;
 }
 
 i32 Player::GetYPixel()
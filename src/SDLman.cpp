@@ -6,6 +6,24 @@
 #include "Timers.h"
 #include "Connection.h"
 #include "Net.h"
+#include "Players.h"
+#include "PerfOverlay.h"
+#include "Trace.h"
+#include <cmath>
+#include <thread>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+#else
+#include <errno.h>
+#include <time.h>
+#endif
 
 struct SDLmanData
 {
@@ -15,14 +33,26 @@ struct SDLmanData
     shared_ptr<Timer> fpsTimer;
     shared_ptr<DrawnText> fpsText;
     shared_ptr<DrawnText> shipInfoText;
+    shared_ptr<PerfOverlay> perfOverlay;
 
     bool shouldExit = false;
     bool escPressedState = false;
+    bool headless = false;  // no video subsystem, see video::headless
+    Uint32 initFlags = 0;
+
+    // sleeps are a high resolution timed wait, then a yield loop for this last bit in case the
+    // wait wakes up early
+    const double SLEEP_YIELD_MS = 0.05;
+#ifdef WIN32
+    HANDLE sleepTimer = nullptr;  // made on first use
+#endif
+    double counterToMs = 0;  // performance counter ticks to ms, set in MainLoop()
 
     void EscapeToggled();
     void AdvanceState(i32 difMs);
     void ProcessEvent(SDL_Event* event);
     void DoIteration(i32 difMs);
+    void PreciseSleep(double ms);
     void PostInit();
     void PreDestroy();
 
@@ -38,6 +68,14 @@ struct SDLmanData
         fpsFrameCount = 0;
     };
 
+    std::function<void(const char*)> perfFunc = [this](const char* textUtf8)
+    {
+        if (string("?perf") == textUtf8)
+            perfOverlay->SetVisible(!perfOverlay->IsVisible());
+        else
+            c.chat->InternalMessage("Expected plain '?perf' command.");
+    };
+
     std::function<void(const char*)> quitFunc = [this](const char* textUtf8)
     {
         if (string("?quit") == textUtf8)
@@ -45,6 +83,37 @@ struct SDLmanData
         else
             c.chat->InternalMessage("Expected plain '?quit' command.");
     };
+
+    // ?trace starts tracing, ?trace again stops and saves it (to trace.json, or ?trace=file.json)
+    std::function<void(const char*)> traceFunc = [this](const char* textUtf8)
+    {
+        string path = "trace.json";
+
+        if (strstr(textUtf8, "?trace=") == textUtf8 && textUtf8[sizeof("?trace")] != 0)
+            path = textUtf8 + sizeof("?trace");
+
+        if (!traceEnabled.load())
+        {
+            TraceStart();
+            c.chat->InternalMessage("Tracing started, use ?trace again to stop and save it.");
+        }
+        else
+        {
+            TraceStop();
+            i32 numEvents = 0;
+
+            if (TraceWriteJson(path.c_str(), &numEvents))
+            {
+                string msg = "Saved " + to_string(numEvents) + " trace zones to " + path + ".";
+                c.chat->InternalMessage(msg.c_str());
+            }
+            else
+            {
+                c.log->LogError("Error writing trace file: %s", path.c_str());
+                c.chat->InternalMessage("Error writing the trace file.");
+            }
+        }
+    };
 };
 
 void SDLmanData::PreDestroy()
@@ -53,6 +122,14 @@ void SDLmanData::PreDestroy()
     fpsTimer = nullptr;
     fpsText = nullptr;
     shipInfoText = nullptr;
+    perfOverlay = nullptr;
+
+#ifdef WIN32
+    if (sleepTimer != nullptr)
+        CloseHandle(sleepTimer);
+
+    sleepTimer = nullptr;
+#endif
 
     // in case we haven't disconnected yet
     c.connection->Disconnect();
@@ -63,8 +140,11 @@ void SDLmanData::PostInit()
     u32 w = 0, h = 0;
     c.graphics->GetScreenSize(&w, &h);
 
-    SDL_Rect rect = {50, (i32)h - 150, 0, 0};
-    SDL_SetTextInputRect(&rect);
+    if (!headless)
+    {
+        SDL_Rect rect = {50, (i32)h - 150, 0, 0};
+        SDL_SetTextInputRect(&rect);
+    }
 
     // load ship info text here
     shipInfoText = c.graphics->MakeDrawnText(Layer_Gauges, Color_Blue,
@@ -73,8 +153,11 @@ void SDLmanData::PostInit()
     shipInfoText->SetVisible(false);
 
     fpsTimer = c.timers->PeriodicTimer("fps_timer", 1000, updateFpsImageFunc);
+    perfOverlay = make_shared<PerfOverlay>(c);
 
     c.chat->AddInternalCommand("quit", quitFunc);
+    c.chat->AddInternalCommand("perf", perfFunc);
+    c.chat->AddInternalCommand("trace", traceFunc);
 }
 
 void SDLmanData::ProcessEvent(SDL_Event* event)
@@ -172,6 +255,9 @@ void SDLmanData::ProcessEvent(SDL_Event* event)
                     case SDLK_ESCAPE:
                         EscapeToggled();
                         break;
+                    case SDLK_F3:
+                        perfOverlay->SetVisible(!perfOverlay->IsVisible());
+                        break;
 
                     case SDLK_RETURN:
                     case SDLK_RETURN2:
@@ -190,13 +276,30 @@ void SDLmanData::ProcessEvent(SDL_Event* event)
 
 void SDLmanData::AdvanceState(i32 ms)
 {
-    c.net->ReceivePackets(ms);
-    c.connection->UpdateConnectionStatus(ms);
+    {
+        TRACE_ZONE("ReceivePackets");
+        c.net->ReceivePackets(ms);
+    }
+
+    {
+        TRACE_ZONE("UpdateConnectionStatus");
+        c.connection->UpdateConnectionStatus(ms);
+    }
 
-    c.ships->AdvanceState(ms);
-    c.timers->AdvanceTime(ms);
+    {
+        TRACE_ZONE("Ships::AdvanceState");
+        c.ships->AdvanceState(ms);
+    }
+
+    {
+        TRACE_ZONE("Timers::AdvanceTime");
+        c.timers->AdvanceTime(ms);
+    }
 
-    c.net->SendPackets(ms);
+    {
+        TRACE_ZONE("SendPackets");
+        c.net->SendPackets(ms);
+    }
 }
 
 void SDLmanData::EscapeToggled()
@@ -214,7 +317,12 @@ void SDLmanData::EscapeToggled()
 
 SDLman::SDLman(Client& c) : Module(c), data(make_shared<SDLmanData>(c))
 {
-    if (SDL_Init(SDL_INIT_EVERYTHING) == -1)
+    data->headless = c.cfg->Values().videoHeadless;
+
+    // headless clients still need timers and the event queue, but no display
+    data->initFlags = data->headless ? SDL_INIT_TIMER | SDL_INIT_EVENTS : SDL_INIT_EVERYTHING;
+
+    if (SDL_Init(data->initFlags) == -1)
         c.log->FatalError("Failed to initialize SDL: %s", SDL_GetError());
 
     c.log->LogDrivel("SDL Initialized Correctly");
@@ -222,7 +330,16 @@ SDLman::SDLman(Client& c) : Module(c), data(make_shared<SDLmanData>(c))
 
 SDLman::~SDLman()
 {
-    SDL_Quit();
+    // subsystems are reference counted, so other clients in the same process keep working
+    SDL_QuitSubSystem(data->initFlags);
+
+    if (SDL_WasInit(SDL_INIT_EVERYTHING) == 0)
+        SDL_Quit();
+}
+
+void SDLman::AdvanceState(i32 ms)
+{
+    data->AdvanceState(ms);
 }
 
 void SDLman::Exit()
@@ -232,71 +349,142 @@ void SDLman::Exit()
 
 void SDLmanData::DoIteration(i32 difMs)
 {
-    // events are processed 60 times a second
-    // rendering might be slower
+    // events are processed once per simulation step
+    // rendering happens at its own rate
+    TRACE_ZONE("Step");
 
     SDL_Event event;
 
     while (SDL_PollEvent(&event))
         ProcessEvent(&event);
 
+    // remember where things were, so rendering can interpolate between steps
+    c.players->SaveInterpolationState();
+    c.graphics->SaveInterpolationState();
+
     AdvanceState(difMs);
+    perfOverlay->RecordStep();
+}
+
+void SDLmanData::PreciseSleep(double ms)
+{
+    u64 endCounter = SDL_GetPerformanceCounter() + (u64)(ms / counterToMs);
+    double waitMs = ms - SLEEP_YIELD_MS;
+
+    if (waitMs > 0)
+    {
+#ifdef WIN32
+        if (sleepTimer == nullptr)
+        {
+            sleepTimer = CreateWaitableTimerExW(nullptr, nullptr,
+                                                CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                                TIMER_ALL_ACCESS);
+
+            // high resolution timers are windows 10 1803 and later
+            if (sleepTimer == nullptr)
+                sleepTimer = CreateWaitableTimerW(nullptr, TRUE, nullptr);
+        }
+
+        LARGE_INTEGER due;
+        due.QuadPart = -(LONGLONG)(waitMs * 10000);  // in 100 ns, negative is relative
+
+        if (sleepTimer != nullptr && SetWaitableTimer(sleepTimer, &due, 0, nullptr, nullptr, FALSE))
+            WaitForSingleObject(sleepTimer, INFINITE);
+        else
+            SDL_Delay((u32)waitMs);
+#else
+        struct timespec remaining;
+        remaining.tv_sec = (time_t)(waitMs / 1000);
+        remaining.tv_nsec = (long)((waitMs - remaining.tv_sec * 1000.0) * 1000000);
+
+        while (nanosleep(&remaining, &remaining) == -1 && errno == EINTR)
+            ;
+#endif
+    }
+
+    while (SDL_GetPerformanceCounter() < endCounter)
+        std::this_thread::yield();
 }
 
 void SDLman::MainLoop()
 {
     data->PostInit();
+    data->counterToMs = 1000.0 / SDL_GetPerformanceFrequency();
 
-    i32 targetFps = c.cfg->GetInt("game", "ticks_per_second", 60, [](i32 val)
-                                  {
-                                      return val > 0;
-                                  });
+    i32 targetFps = c.cfg->Values().gameTicksPerSecond;
+    i32 maxFps = c.cfg->Values().videoMaxFps;
 
-    u32 msPerIteration = round(1000.0 / targetFps);
+    // the simulation advances in fixed steps, rendering happens as often as the display allows
+    double msPerIteration = 1000.0 / targetFps;
+    double msPerFrame = 0;  // 0 = no frame limit (vsync paces us)
 
-    u32 lastIterationMs = SDL_GetTicks();
-    u32 difMs = 0;
+    if (maxFps > 0)
+        msPerFrame = 1000.0 / maxFps;
+    else if (data->headless)
+        msPerFrame = msPerIteration;  // nothing is shown, so one frame per step is plenty
+    else if (!c.graphics->HasVsync())
+        msPerFrame = 1000.0 / c.graphics->GetRefreshRate();
 
-    SDL_StartTextInput();
+    double accumulatorMs = 0;  // time that hasn't been simulated yet
+    double simulatedMs = 0;    // used to hand out whole ms to each step without drift
+    double renderCarryMs = 0;  // fraction of a ms not yet passed to Render()
 
-    while (!data->shouldExit)
-    {
-        while (difMs < msPerIteration)
-        {
-            u32 nowMs = SDL_GetTicks();
-            difMs = nowMs - lastIterationMs;
+    u64 lastCounter = SDL_GetPerformanceCounter();
 
-            if (difMs < msPerIteration)
-                SDL_Delay(1);
-        }
+    if (!data->headless)
+        SDL_StartTextInput();
 
-        // at this point difMs >= msPerIteration
+    while (!data->shouldExit)
+    {
+        u64 frameStartCounter = SDL_GetPerformanceCounter();
+        double difMs = (frameStartCounter - lastCounter) * data->counterToMs;
+        lastCounter = frameStartCounter;
 
         if (difMs >= 2000)
-            c.log->LogError("Slow Main Loop Iteration: difMs=%d\n", difMs);
+            c.log->LogError("Slow Main Loop Iteration: difMs=%.0f\n", difMs);
 
         if (difMs >= 5000)
         {
-            c.log->LogError("Main loop iteration could not keep up (difMs=%d). Exiting.", difMs);
+            c.log->LogError("Main loop iteration could not keep up (difMs=%.0f). Exiting.", difMs);
             break;
         }
 
-        // advance time in increments of msPerIteration
-        i32 timeAdvanced = 0;
-        while (difMs >= msPerIteration)
+        accumulatorMs += difMs;
+        i32 steps = 0;
+
+        while (accumulatorMs >= msPerIteration)
         {
-            timeAdvanced += msPerIteration;
-            difMs -= msPerIteration;
-            data->DoIteration(msPerIteration);
-            lastIterationMs += msPerIteration;
+            // steps are 16 or 17 ms at 60 ticks per second, summing to the exact time
+            i32 stepMs = (i32)(floor(simulatedMs + msPerIteration) - floor(simulatedMs));
+
+            simulatedMs += msPerIteration;
+            accumulatorMs -= msPerIteration;
+
+            data->DoIteration(stepMs);
+            ++steps;
         }
 
-        // render
-        c.graphics->Render(timeAdvanced);
+        // render, interpolating between the last two simulation steps
+        renderCarryMs += difMs;
+        i32 renderMs = (i32)renderCarryMs;
+        renderCarryMs -= renderMs;
+
+        c.graphics->Render(renderMs, (float)(accumulatorMs / msPerIteration));
         ++data->fpsFrameCount;
+        data->perfOverlay->RecordFrame(difMs, steps);
+
+        if (msPerFrame > 0)
+        {
+            u64 nowCounter = SDL_GetPerformanceCounter();
+            double frameMs = (nowCounter - frameStartCounter) * data->counterToMs;
+
+            if (frameMs < msPerFrame)
+                data->PreciseSleep(msPerFrame - frameMs);
+        }
     }
 
-    SDL_StopTextInput();
+    if (!data->headless)
+        SDL_StopTextInput();
 
     data->PreDestroy();
 }
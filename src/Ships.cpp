@@ -2,8 +2,172 @@
 #include "Graphics.h"
 #include "Players.h"
 #include "Net.h"
+#include "Map.h"
+#include "Connection.h"
+#include "Trace.h"
+#include "dship.h"
+#include "dphysics_packets.h"
 using namespace std;
 
+// inputs kept for replaying after a server frame (power of two), 4 seconds of ticks
+static const u32 INPUT_HISTORY = 256;
+
+struct InputRecord
+{
+    u32 tick;
+    u8 buttons;       // SHIP_INPUT_ bits
+    ShipState after;  // the predicted state once this tick's input was applied
+};
+
+// a weapon that's missing from frames for this long is dropped, frames are unreliable so one
+// missing frame doesn't mean it's gone
+static const u32 WEAPON_TIMEOUT_MS = 250;
+
+// weapons from the server's frames, as one array per field so extrapolating all of them each
+// render frame is a single pass over contiguous floats
+struct Projectiles
+{
+    vector<u16> id;
+    vector<u8> type;           // WEAPON_ in dphysics_packets.h
+    vector<float> x, y;        // map pixels at sampleMs
+    vector<float> xvel, yvel;  // map pixels per ms
+    vector<u32> sampleMs;      // ShipsData::clockMs of the last frame that had it
+
+    vector<i32> indexOfId = vector<i32>(65536, -1);  // -1 if the id isn't tracked
+
+    // where they are drawn this render frame, filled by Extrapolate()
+    vector<float> drawX, drawY;
+
+    u32 Count() { return id.size(); }
+
+    void Set(u32 i, const WeaponState* ws, u32 nowMs)
+    {
+        type[i] = ws->type;
+        x[i] = ws->xpixel;
+        y[i] = ws->ypixel;
+        xvel[i] = ws->xvel / 10000.0f;
+        yvel[i] = ws->yvel / 10000.0f;
+        sampleMs[i] = nowMs;
+    }
+
+    // the index of ws's weapon, added if it's new
+    u32 Update(const WeaponState* ws, u32 nowMs)
+    {
+        i32 rv = indexOfId[ws->id];
+
+        if (rv == -1)
+        {
+            rv = Count();
+            indexOfId[ws->id] = rv;
+            id.push_back(ws->id);
+            type.push_back(0);
+            x.push_back(0);
+            y.push_back(0);
+            xvel.push_back(0);
+            yvel.push_back(0);
+            sampleMs.push_back(0);
+        }
+
+        Set(rv, ws, nowMs);
+
+        return rv;
+    }
+
+    // the last one takes its place
+    void Remove(u32 i)
+    {
+        u32 last = Count() - 1;
+
+        indexOfId[id[i]] = -1;
+
+        if (i != last)
+        {
+            id[i] = id[last];
+            type[i] = type[last];
+            x[i] = x[last];
+            y[i] = y[last];
+            xvel[i] = xvel[last];
+            yvel[i] = yvel[last];
+            sampleMs[i] = sampleMs[last];
+            indexOfId[id[i]] = i;
+        }
+
+        id.pop_back();
+        type.pop_back();
+        x.pop_back();
+        y.pop_back();
+        xvel.pop_back();
+        yvel.pop_back();
+        sampleMs.pop_back();
+    }
+
+    void Clear()
+    {
+        while (Count() > 0)
+            Remove(Count() - 1);
+    }
+
+    void Expire(u32 nowMs)
+    {
+        for (u32 i = Count(); i-- > 0;)
+        {
+            if (nowMs - sampleMs[i] > WEAPON_TIMEOUT_MS)
+                Remove(i);
+        }
+    }
+
+    // move each weapon along its velocity from its last sample to baseMs + fracMs (which can be
+    // between simulation steps), no walls: the server's next frame says if it hit one. The age is
+    // taken in integer ms first, a float clock would lose ms resolution after a few hours.
+    void Extrapolate(u32 baseMs, float fracMs)
+    {
+        u32 count = Count();
+
+        drawX.resize(count);
+        drawY.resize(count);
+
+        const float* px = x.data();
+        const float* py = y.data();
+        const float* vx = xvel.data();
+        const float* vy = yvel.data();
+        const u32* sample = sampleMs.data();
+        float* outX = drawX.data();
+        float* outY = drawY.data();
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            float age = (i32)(baseMs - sample[i]) + fracMs;
+
+            outX[i] = px[i] + vx[i] * age;
+            outY[i] = py[i] + vy[i] * age;
+        }
+    }
+};
+
+// how each type of weapon is drawn, one batch of rects per color
+enum WeaponLook
+{
+    Look_Bullet,
+    Look_Bomb,
+    Look_Other,
+    NUM_LOOKS
+};
+
+static const TextColor LOOK_COLORS[NUM_LOOKS] = {Color_Yellow, Color_Red, Color_Purple};
+static const i32 LOOK_SIZES[NUM_LOOKS] = {3, 6, 4};  // pixels per side
+
+static WeaponLook GetWeaponLook(u8 type)
+{
+    WeaponLook rv = Look_Other;
+
+    if (type == WEAPON_BULLET || type == WEAPON_BOUNCEBULLET)
+        rv = Look_Bullet;
+    else if (type == WEAPON_BOMB || type == WEAPON_PROXBOMB || type == WEAPON_THOR)
+        rv = Look_Bomb;
+
+    return rv;
+}
+
 struct ShipsData
 {
     Client& c;
@@ -26,6 +190,25 @@ struct ShipsData
 
     bool moveKeys[4] = {false, false, false, false};
 
+    // prediction: the own ship is moved by its inputs right away, using the same steps as the
+    // server (dship.h). After each frame the server sends its exact state of the ship and the last
+    // input tick it applied, so the ship is reset to that state and the later inputs are replayed.
+    InputRecord inputHistory[INPUT_HISTORY] = {};
+    u32 nextTick = 0;           // the tick of the next input
+    u32 shipStartTick = 0;      // the first input in the current ship, older ones aren't sent
+    i32 tickAccumulatorMs = 0;  // time not yet covered by input ticks
+    i32 smoothMs = 0;           // corrections are blended in over this long, 0 = snap
+    i32 snapDistance = 0;       // pixels * 10000, bigger corrections always snap
+    bool haveFrame = false;
+    u32 lastFrameNum = 0;
+    bool haveSelfState = false;
+    u32 lastAckedTick = 0;
+
+    Projectiles weapons;
+    u32 clockMs = 0;  // in-game time, advanced each simulation step
+    i32 lastStepMs = 0;
+    vector<SDL_Rect> weaponRects[NUM_LOOKS];  // reused each render frame
+
     i32 totalMs = 0;
 
     bool inGame = false;
@@ -81,6 +264,9 @@ struct ShipsData
 
     void ShipChanged(ShipType s)
     {
+        shipStartTick = nextTick;
+        tickAccumulatorMs = 0;
+
         if (s == Ship_Spec)
             selfImage = nullptr;
         else
@@ -90,6 +276,330 @@ struct ShipsData
         }
     }
 
+    u8 GetButtons()
+    {
+        u8 rv = 0;
+
+        if (moveKeys[0])
+            rv |= SHIP_INPUT_UP;
+
+        if (moveKeys[1])
+            rv |= SHIP_INPUT_DOWN;
+
+        if (moveKeys[2])
+            rv |= SHIP_INPUT_LEFT;
+
+        if (moveKeys[3])
+            rv |= SHIP_INPUT_RIGHT;
+
+        return rv;
+    }
+
+    void GetShipParams(ShipType s, ShipParams* store)
+    {
+        const ShipSettings* ss = &c.net->GetArenaSettings()->ships[s];
+
+        store->rotation = ss->InitialRotation;
+        store->thrust = ss->InitialThrust;
+        store->speed = ss->InitialSpeed;
+        store->radius = ss->Radius;
+    }
+
+    static void ToShipState(const PlayerPhysics* p, ShipState* store)
+    {
+        store->x = p->x;
+        store->y = p->y;
+        store->xvel = p->xvel;
+        store->yvel = p->yvel;
+        store->rot = p->rot;
+    }
+
+    static void FromShipState(const ShipState* s, PlayerPhysics* store)
+    {
+        store->x = s->x;
+        store->y = s->y;
+        store->xvel = s->xvel;
+        store->yvel = s->yvel;
+        store->rot = s->rot;
+    }
+
+    // record this tick's input and apply it to the own ship
+    void PredictSelf()
+    {
+        InputRecord* r = &inputHistory[nextTick % INPUT_HISTORY];
+        r->tick = nextTick;
+        r->buttons = GetButtons();
+
+        ShipParams params;
+        ShipState state;
+
+        GetShipParams(self->ship, &params);
+        ToShipState(&self->physics, &state);
+        shipStep(c.map->GetCollisionMap(), &state, &params, r->buttons, shipTickMs(r->tick));
+        FromShipState(&state, &self->physics);
+        r->after = state;
+
+        ++nextTick;
+    }
+
+    // C2S_DISC2_INPUT with the latest ticks of input, see dphysics_packets.h
+    void SendInput()
+    {
+        u8 packet[INPUT_PACKET_MAX_LEN] = {};
+        u32 numTicks = min(nextTick - shipStartTick, (u32)INPUT_PACKET_MAX_TICKS);
+        u32 newestTick = nextTick - 1;
+
+        InputHeader header;
+        header.packetType = C2S_DISC2_INPUT;
+        header.newestTick = newestTick;
+        header.numTicks = numTicks;
+        memcpy(packet, &header, sizeof(header));
+
+        u8* bits = packet + sizeof(header);
+        u32 numBits = 0;
+
+        auto putBits = [bits, &numBits](u32 value, u32 count)
+        {
+            for (u32 i = 0; i < count; ++i, ++numBits)
+            {
+                if (value & (1 << i))
+                    bits[numBits / 8] |= 1 << (numBits % 8);
+            }
+        };
+
+        u8 prevButtons = inputHistory[newestTick % INPUT_HISTORY].buttons;
+        putBits(prevButtons, 4);
+
+        for (u32 i = 1; i < numTicks; ++i)
+        {
+            u8 buttons = inputHistory[(newestTick - i) % INPUT_HISTORY].buttons;
+
+            if (buttons == prevButtons)
+                putBits(0, 1);
+            else
+            {
+                putBits(1, 1);
+                putBits(buttons, 4);
+                prevButtons = buttons;
+            }
+        }
+
+        c.net->SendRawPacket(packet, sizeof(header) + (numBits + 7) / 8);
+    }
+
+    void DecayDrawOffset(i32 ms)
+    {
+        if (smoothMs <= 0 || ms >= smoothMs)
+        {
+            self->drawOffsetX = 0;
+            self->drawOffsetY = 0;
+        }
+        else
+        {
+            self->drawOffsetX -= (i32)((i64)self->drawOffsetX * ms / smoothMs);
+            self->drawOffsetY -= (i32)((i64)self->drawOffsetY * ms / smoothMs);
+        }
+    }
+
+    // true if the server's state is what was predicted, to the precision of the frame
+    static bool SameState(const ShipState* a, const ShipState* b)
+    {
+        return a->x == b->x && a->y == b->y && a->xvel == b->xvel && a->yvel == b->yvel &&
+               a->rot == b->rot;
+    }
+
+    // server is the server's state after ackedTick, replay the inputs since then on top of it
+    void Reconcile(u32 ackedTick, const ShipState* server)
+    {
+        const InputRecord* acked = &inputHistory[ackedTick % INPUT_HISTORY];
+
+        // too old to replay (or not made yet), wait for a newer frame
+        if (nextTick - ackedTick > INPUT_HISTORY || ackedTick >= nextTick ||
+            acked->tick != ackedTick)
+            return;
+
+        // the prediction was right, nothing to do
+        if (SameState(&acked->after, server))
+            return;
+
+        ShipParams params;
+        ShipState replayed = *server;
+        const CollisionMap* map = c.map->GetCollisionMap();
+
+        GetShipParams(self->ship, &params);
+
+        for (u32 tick = ackedTick + 1; tick < nextTick; ++tick)
+        {
+            InputRecord* r = &inputHistory[tick % INPUT_HISTORY];
+
+            shipStep(map, &replayed, &params, r->buttons, shipTickMs(tick));
+            r->after = replayed;
+        }
+
+        i32 errorX = self->physics.x - replayed.x;
+        i32 errorY = self->physics.y - replayed.y;
+
+        if (errorX != 0 || errorY != 0)
+        {
+            i64 errorSq = (i64)errorX * errorX + (i64)errorY * errorY;
+
+            // keep drawing where the ship was, and let the offset shrink from there
+            if (smoothMs > 0 && errorSq <= (i64)snapDistance * snapDistance)
+            {
+                self->drawOffsetX += errorX;
+                self->drawOffsetY += errorY;
+            }
+            else
+            {
+                self->drawOffsetX = 0;
+                self->drawOffsetY = 0;
+            }
+        }
+
+        FromShipState(&replayed, &self->physics);
+    }
+
+    // S2C_DISC2_FRAME, the server's physics state, sent unreliably every tick
+    std::function<void(const u8*, i32)> handleFrame = [this](const u8* bytes, i32 len)
+    {
+        FrameHeader header;
+
+        if (len < (i32)sizeof(header))
+        {
+            c.log->LogError("Physics frame too short (%d bytes)", len);
+            return;
+        }
+
+        memcpy(&header, bytes, sizeof(header));
+
+        i32 expectedLen = sizeof(FrameHeader) + header.numPidStates * sizeof(PidState) +
+                          header.numPlayerStates * sizeof(PlayerState) +
+                          header.numWeaponStates * sizeof(WeaponState);
+
+        if (len != expectedLen)
+        {
+            c.log->LogError("Physics frame %u is %d bytes, but its header says %d", header.frameNum,
+                            len, expectedLen);
+            return;
+        }
+
+        // frames are unreliable, so they can arrive late or out of order (the parts of a split
+        // frame share its frameNum)
+        if (haveFrame && (i32)(header.frameNum - lastFrameNum) < 0)
+            return;
+
+        haveFrame = true;
+        lastFrameNum = header.frameNum;
+
+        if (!inGame)
+            return;
+
+        const u8* cur = bytes + sizeof(FrameHeader) + header.numPidStates * sizeof(PidState);
+
+        for (i32 i = 0; i < header.numPlayerStates; ++i, cur += sizeof(PlayerState))
+        {
+            PlayerState ps;
+            memcpy(&ps, cur, sizeof(ps));
+
+            if (ps.pid != self->pid)
+            {
+                shared_ptr<Player> p = c.players->GetPlayer(ps.pid);
+
+                if (p)
+                {
+                    p->physics.x = ps.xpixel * 10000;
+                    p->physics.y = ps.ypixel * 10000;
+                    p->physics.xvel = ps.xvel * 1000;
+                    p->physics.yvel = ps.yvel * 1000;
+                    p->physics.rot = ps.rot * SHIP_FULL_ROTATION / SHIP_DIRECTIONS;
+                }
+            }
+        }
+
+        for (i32 i = 0; i < header.numWeaponStates; ++i, cur += sizeof(WeaponState))
+        {
+            WeaponState ws;
+            memcpy(&ws, cur, sizeof(ws));
+
+            u32 index = weapons.Update(&ws, clockMs);
+
+            if (ws.exploded)
+            {
+                c.graphics->MakeSingleDrawnAnimation(Layer_AfterShips, ws.xpixel, ws.ypixel,
+                                                     explodeBombAnimation, true);
+                weapons.Remove(index);
+            }
+        }
+    };
+
+    // S2C_DISC2_SELF, the server's exact state of the own ship after one of its input ticks
+    std::function<void(const u8*, i32)> handleSelf = [this](const u8* bytes, i32 len)
+    {
+        SelfState ss;
+
+        if (len != (i32)sizeof(ss))
+        {
+            c.log->LogError("Self state packet is %d bytes, expected %d", len, (i32)sizeof(ss));
+            return;
+        }
+
+        memcpy(&ss, bytes, sizeof(ss));
+
+        // unreliable as well, an older tick than one already reconciled is stale
+        if (!inGame || self->ship == Ship_Spec ||
+            (haveSelfState && (i32)(ss.inputTick - lastAckedTick) <= 0))
+            return;
+
+        haveSelfState = true;
+        lastAckedTick = ss.inputTick;
+
+        ShipState server;
+        server.x = ss.x;
+        server.y = ss.y;
+        server.xvel = ss.xvel;
+        server.yvel = ss.yvel;
+        server.rot = ss.rot;
+
+        Reconcile(ss.inputTick, &server);
+    };
+
+    void DrawWeapons(float alpha)
+    {
+        u32 count = weapons.Count();
+        u32 w = 0, h = 0;
+
+        c.graphics->GetScreenSize(&w, &h);
+
+        // the same point in time that the ships are interpolated to, between the last two steps
+        weapons.Extrapolate(clockMs - lastStepMs, alpha * lastStepMs);
+
+        i32 offsetX = w / 2 - self->GetDrawXPixel(alpha);
+        i32 offsetY = h / 2 - self->GetDrawYPixel(alpha);
+
+        for (i32 look = 0; look < NUM_LOOKS; ++look)
+            weaponRects[look].clear();
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            i32 look = GetWeaponLook(weapons.type[i]);
+            i32 size = LOOK_SIZES[look];
+            i32 left = (i32)weapons.drawX[i] + offsetX - size / 2;
+            i32 top = (i32)weapons.drawY[i] + offsetY - size / 2;
+
+            if (left + size >= 0 && top + size >= 0 && left < (i32)w && top < (i32)h)
+            {
+                SDL_Rect r = {left, top, size, size};
+                weaponRects[look].push_back(r);
+            }
+        }
+
+        for (i32 look = 0; look < NUM_LOOKS; ++look)
+        {
+            c.graphics->DrawRects(weaponRects[look].data(), weaponRects[look].size(),
+                                  LOOK_COLORS[look]);
+        }
+    }
+
     void DrawInGame(i32 difMs)
     {
         int forwardMult = 0;
@@ -112,11 +622,33 @@ struct ShipsData
             self->physics.y -= difMs * forwardMult * MOVE_SPEED;
             self->physics.x -= difMs * leftMult * MOVE_SPEED;
         }
+        else
+        {
+            // input ticks are always SHIP_TICKS_PER_SECOND (the server steps once per tick), so
+            // a step can make zero or several of them if game::ticks_per_second is different
+            bool madeTick = false;
+
+            tickAccumulatorMs += difMs;
+
+            while (tickAccumulatorMs >= shipTickMs(nextTick))
+            {
+                tickAccumulatorMs -= shipTickMs(nextTick);
+                PredictSelf();
+                madeTick = true;
+            }
+
+            if (madeTick && c.connection->isCompletelyConnected())
+                SendInput();
+        }
+
+        DecayDrawOffset(difMs);
 
         // update the player ship image
         if (selfImage)
         {
-            selfImage->SetCenterPosition(self->GetXPixel(), self->GetYPixel());
+            // drawn where the view is centered, including what's left of a correction
+            selfImage->SetCenterPosition((self->physics.x + self->drawOffsetX) / 10000,
+                                         (self->physics.y + self->drawOffsetY) / 10000);
 
             int frame = 40 * (int)self->ship;
             frame += self->GetRotFrame();
@@ -135,7 +667,13 @@ Ships::Ships(Client& c) : Module(c), data(make_shared<ShipsData>(c))
     data->explodeBombImage = c.graphics->LoadImage("explode1", 6, 6);
     data->explodeBombAnimation = c.graphics->InitAnimation(data->explodeBombImage, 1000);
 
+    data->smoothMs = c.cfg->Values().gamePredictionSmoothMs;
+    data->snapDistance = c.cfg->Values().gamePredictionSnapPixels * 10000;
+
     data->InitDemo();
+
+    c.net->AddRawPacketHandler(make_pair(false, S2C_DISC2_FRAME), data->handleFrame);
+    c.net->AddRawPacketHandler(make_pair(false, S2C_DISC2_SELF), data->handleSelf);
 }
 
 void Ships::AdvanceState(i32 difMs)
@@ -145,13 +683,28 @@ void Ships::AdvanceState(i32 difMs)
     if (!data->inGame)
         data->DrawDemo();
     else
+    {
+        data->clockMs += difMs;
+        data->lastStepMs = difMs;
+        data->weapons.Expire(data->clockMs);
+
         data->DrawInGame(difMs);
+    }
+}
+
+void Ships::DrawWeapons(float alpha)
+{
+    TRACE_ZONE("DrawWeapons");
+
+    if (data->inGame && data->weapons.Count() > 0)
+        data->DrawWeapons(alpha);
 }
 
 void Ships::NowInGame()
 {
     data->DeinitDemo();
     data->self = c.players->GetSelfPlayer();
+    data->weapons.Clear();
     data->NowInGame();
 }
 
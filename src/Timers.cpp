@@ -1,103 +1,312 @@
 #include "Timers.h"
 #include <vector>
 
+// Timers are kept in a hierarchical timing wheel (like the classic Linux kernel timers), with a
+// resolution of 1 ms. Level 0 has one slot per ms for the next 256 ms, each higher level has
+// slots that are 256 times as wide. When the lower level wraps around, the next slot of the level
+// above is cascaded down. Scheduling and cancelling are O(1), and advancing time only touches
+// timers that expire (or cascade), not every timer that is registered.
+//
+// All timers live in a single pool of nodes linked by index, each wheel slot is a sentinel node
+// at the start of the pool. Since a node knows its own neighbors it can be unlinked from whatever
+// list it's in.
+struct TimerNode
+{
+    i32 prev = -1;
+    i32 next = -1;
+    u32 generation = 1;  // incremented when freed, so stale TimerHandles can be detected
+    bool inUse = false;
+
+    u64 expireMs = 0;
+    Timer* periodic = nullptr;  // owning periodic timer, or nullptr for single timers
+    std::function<void()> f;    // single timers only
+};
+
 struct TimersData
 {
     TimersData(Client& c);
 
+    const i32 WHEEL_BITS = 8;
+    const i32 WHEEL_SIZE = 1 << WHEEL_BITS;
+    const i32 WHEEL_MASK = WHEEL_SIZE - 1;
+    const i32 WHEEL_LEVELS = 4;  // 32 bits of ms, more than any i32 delay
+
+    const i32 EXPIRING_HEAD = WHEEL_LEVELS * WHEEL_SIZE;
+    const i32 CASCADE_HEAD = EXPIRING_HEAD + 1;
+    const i32 NUM_HEADS = CASCADE_HEAD + 1;
+
     Client& c;
 
-    vector<Timer*> timersList;
-    vector<pair<i32, std::function<void()>>> singleTimers;
+    vector<TimerNode> nodes;
+    i32 freeList = -1;
+
+    u64 nowMs = 0;    // time that newly created timers are relative to
+    u64 wheelMs = 0;  // next tick the wheel will process
+
+    i32 AllocNode();
+    void FreeNode(i32 n);
+
+    void Link(i32 head, i32 n);
+    void Unlink(i32 n);
+    void Splice(i32 fromHead, i32 toHead);
+    bool IsEmpty(i32 head) { return nodes[head].next == head; }
+
+    void Schedule(i32 n);
+    i32 Cascade(i32 level);
+    void RunTick();
 };
 
 struct Timer
 {
     Timer(shared_ptr<TimersData> td, const char* name, i32 repeatMs, std::function<void()> f)
-        : td(td), name(name), repeatMs(repeatMs), curDelay(repeatMs), f(f)
+        : td(td), name(name), repeatMs(repeatMs), f(f)
     {
         if (repeatMs <= 0)
         {
             td->c.log->LogError("Tried to set timer with repeatMs=%d", repeatMs);
-            curDelay = repeatMs = 1000;
+            this->repeatMs = 1000;
         }
 
-        td->timersList.push_back(this);
+        node = td->AllocNode();
+        td->nodes[node].periodic = this;
+        td->nodes[node].expireMs = td->nowMs + this->repeatMs;
+        td->Schedule(node);
     }
 
     ~Timer()
     {
-        // erase it from timersList
-        for (u32 i = 0; i < td->timersList.size(); ++i)
-        {
-            if (td->timersList[i] == this)
-            {
-                td->timersList[i] = td->timersList[td->timersList.size() - 1];
-                td->timersList.pop_back();
-                break;
-            }
-        }
+        td->Unlink(node);
+        td->FreeNode(node);
     }
 
     shared_ptr<TimersData> td;
     const char* name;
     i32 repeatMs;
-    i32 curDelay;
     std::function<void()> f;
+    i32 node = -1;
 };
 
-TimersData::TimersData(Client& c) : c(c)
+TimersData::TimersData(Client& c) : c(c), nodes(NUM_HEADS)
 {
+    // each list head starts out pointing to itself (empty)
+    for (i32 i = 0; i < NUM_HEADS; ++i)
+        nodes[i].prev = nodes[i].next = i;
 }
 
-Timers::Timers(Client& c) : Module(c), data(make_shared<TimersData>(c))
+i32 TimersData::AllocNode()
 {
+    i32 rv = freeList;
+
+    if (rv != -1)
+        freeList = nodes[rv].next;
+    else
+    {
+        rv = nodes.size();
+        nodes.push_back(TimerNode());
+    }
+
+    nodes[rv].inUse = true;
+    nodes[rv].prev = nodes[rv].next = rv;
+
+    return rv;
 }
 
-Timers::~Timers()
+void TimersData::FreeNode(i32 n)
 {
-    for (Timer* t : data->timersList)
-        c.log->LogError("Timer was not cleaned up correctly: '%s'", t->name);
+    TimerNode& node = nodes[n];
+
+    node.inUse = false;
+    ++node.generation;
+    node.periodic = nullptr;
+    node.f = nullptr;
+
+    node.prev = -1;
+    node.next = freeList;
+    freeList = n;
 }
 
-shared_ptr<Timer> Timers::PeriodicTimer(const char* name, i32 mills, std::function<void()> f)
+// add n to the end of the list at head
+void TimersData::Link(i32 head, i32 n)
 {
-    return make_shared<Timer>(data, name, mills, f);
+    i32 last = nodes[head].prev;
+
+    nodes[n].prev = last;
+    nodes[n].next = head;
+    nodes[last].next = n;
+    nodes[head].prev = n;
 }
 
-void Timers::AdvanceTime(i32 ms)
+void TimersData::Unlink(i32 n)
 {
-    // handle single timers
-    for (u32 i = 0; i < data->singleTimers.size(); /* increment in loop */)
+    i32 prev = nodes[n].prev;
+    i32 next = nodes[n].next;
+
+    nodes[prev].next = next;
+    nodes[next].prev = prev;
+    nodes[n].prev = nodes[n].next = n;
+}
+
+// move the entire list at fromHead to toHead (which must be empty)
+void TimersData::Splice(i32 fromHead, i32 toHead)
+{
+    if (IsEmpty(fromHead))
+        return;
+
+    i32 first = nodes[fromHead].next;
+    i32 last = nodes[fromHead].prev;
+
+    nodes[toHead].next = first;
+    nodes[toHead].prev = last;
+    nodes[first].prev = toHead;
+    nodes[last].next = toHead;
+
+    nodes[fromHead].prev = nodes[fromHead].next = fromHead;
+}
+
+// put n into the wheel slot for its expiration time
+void TimersData::Schedule(i32 n)
+{
+    u64 expire = nodes[n].expireMs;
+    i32 head = 0;
+
+    if (expire < wheelMs)
+        head = wheelMs & WHEEL_MASK;  // already expired, run on the next tick
+    else
     {
-        data->singleTimers[i].first -= ms;
+        u64 delta = expire - wheelMs;
+        i32 level = 0;
 
-        if (data->singleTimers[i].first <= 0)
-        {
-            data->singleTimers[i].second();
+        while (level < WHEEL_LEVELS - 1 && delta >= (u64)1 << (WHEEL_BITS * (level + 1)))
+            ++level;
 
-            // delete it by copying last and popping
-            data->singleTimers[i] = data->singleTimers[data->singleTimers.size() - 1];
-            data->singleTimers.pop_back();
+        head = level * WHEEL_SIZE + ((expire >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    }
+
+    Link(head, n);
+}
+
+// re-schedule all the timers in the current slot of the given level (they'll move down a level)
+// returns the slot index, 0 means the level above needs to be cascaded as well
+i32 TimersData::Cascade(i32 level)
+{
+    i32 index = (wheelMs >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+    Splice(level * WHEEL_SIZE + index, CASCADE_HEAD);
+
+    while (!IsEmpty(CASCADE_HEAD))
+    {
+        i32 n = nodes[CASCADE_HEAD].next;
+
+        Unlink(n);
+        Schedule(n);
+    }
+
+    return index;
+}
+
+void TimersData::RunTick()
+{
+    i32 index = wheelMs & WHEEL_MASK;
+
+    if (index == 0)
+    {
+        for (i32 level = 1; level < WHEEL_LEVELS; ++level)
+        {
+            if (Cascade(level) != 0)
+                break;
         }
-        else
-            ++i;  // didn't delete, increment
     }
 
-    // handle repeating timers
-    for (u32 i = 0; i < data->timersList.size(); ++i)
+    // timers created by the callbacks are relative to this tick
+    nowMs = wheelMs++;
+
+    Splice(index, EXPIRING_HEAD);
+
+    while (!IsEmpty(EXPIRING_HEAD))
     {
-        data->timersList[i]->curDelay -= ms;
+        i32 n = nodes[EXPIRING_HEAD].next;
+        std::function<void()> f;
+
+        Unlink(n);
 
-        while (i < data->timersList.size() && data->timersList[i]->curDelay <= 0)
+        if (nodes[n].periodic)
         {
-            data->timersList[i]->curDelay += data->timersList[i]->repeatMs;
-            data->timersList[i]->f();
+            Timer* t = nodes[n].periodic;
+
+            // reschedule first, so that the callback can safely delete the timer
+            nodes[n].expireMs += t->repeatMs;
+            Schedule(n);
+
+            f = t->f;
         }
+        else
+        {
+            f = std::move(nodes[n].f);
+            FreeNode(n);
+        }
+
+        // callbacks may add or cancel timers (which can reallocate nodes)
+        f();
     }
 }
 
-void Timers::SingleTimer(i32 delayMs, std::function<void()> f)
+Timers::Timers(Client& c) : Module(c), data(make_shared<TimersData>(c))
+{
+}
+
+Timers::~Timers()
 {
-    data->singleTimers.push_back(make_pair(delayMs, f));
+    for (const TimerNode& n : data->nodes)
+    {
+        if (n.inUse && n.periodic)
+            c.log->LogError("Timer was not cleaned up correctly: '%s'", n.periodic->name);
+    }
+}
+
+shared_ptr<Timer> Timers::PeriodicTimer(const char* name, i32 mills, std::function<void()> f)
+{
+    return make_shared<Timer>(data, name, mills, f);
+}
+
+void Timers::AdvanceTime(i32 ms)
+{
+    u64 targetMs = data->nowMs + ms;
+
+    while (data->wheelMs <= targetMs)
+        data->RunTick();
+
+    data->nowMs = targetMs;
+}
+
+TimerHandle Timers::SingleTimer(i32 delayMs, std::function<void()> f)
+{
+    i32 n = data->AllocNode();
+    TimerNode& node = data->nodes[n];
+
+    node.f = f;
+    node.expireMs = data->nowMs + (delayMs > 0 ? delayMs : 1);
+    data->Schedule(n);
+
+    return ((TimerHandle)node.generation << 32) | (u32)n;
+}
+
+bool Timers::CancelTimer(TimerHandle h)
+{
+    bool rv = false;
+    i32 n = (i32)(h & 0xFFFFFFFF);
+    u32 generation = (u32)(h >> 32);
+
+    if (n >= data->NUM_HEADS && n < (i32)data->nodes.size())
+    {
+        TimerNode& node = data->nodes[n];
+
+        if (node.inUse && node.periodic == nullptr && node.generation == generation)
+        {
+            data->Unlink(n);
+            data->FreeNode(n);
+            rv = true;
+        }
+    }
+
+    return rv;
 }
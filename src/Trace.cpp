@@ -0,0 +1,151 @@
+#include "Trace.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// zones kept per thread, the oldest are overwritten (power of two)
+static const u32 TRACE_RING_EVENTS = 1 << 16;
+
+struct TraceEvent
+{
+    const char* name;
+    u64 startMicros;
+    u64 endMicros;
+};
+
+// written only by its own thread; read by TraceWriteJson once tracing has stopped
+struct TraceBuffer
+{
+    i32 threadIndex = 0;
+    vector<TraceEvent> events;
+    std::atomic<u64> count;  // zones recorded since TraceStart()
+
+    TraceBuffer() : events(TRACE_RING_EVENTS), count(0) {}
+};
+
+std::atomic<bool> traceEnabled(false);
+
+static std::mutex traceMutex;  // for the buffer list and names, not for recording
+static vector<shared_ptr<TraceBuffer>> traceBuffers;
+static set<string> traceNames;
+static u64 traceStartMicros = 0;
+static thread_local TraceBuffer* threadTraceBuffer = nullptr;
+
+u64 TraceNowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceStart()
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+
+    for (auto& b : traceBuffers)
+        b->count.store(0);
+
+    traceStartMicros = TraceNowMicros();
+    traceEnabled.store(true);
+}
+
+void TraceStop()
+{
+    traceEnabled.store(false);
+}
+
+const char* TraceName(const string& name)
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+
+    return traceNames.insert(name).first->c_str();
+}
+
+void TraceRecord(const char* name, u64 startMicros, u64 endMicros)
+{
+    TraceBuffer* b = threadTraceBuffer;
+
+    if (b == nullptr)
+    {
+        // first zone on this thread
+        shared_ptr<TraceBuffer> newBuffer = make_shared<TraceBuffer>();
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        newBuffer->threadIndex = (i32)traceBuffers.size() + 1;
+        traceBuffers.push_back(newBuffer);
+        b = threadTraceBuffer = newBuffer.get();
+    }
+
+    u64 n = b->count.load(std::memory_order_relaxed);
+    TraceEvent* e = &b->events[n & (TRACE_RING_EVENTS - 1)];
+
+    e->name = name;
+    e->startMicros = startMicros;
+    e->endMicros = endMicros;
+
+    b->count.store(n + 1, std::memory_order_release);
+}
+
+static void WriteJsonString(FILE* f, const char* s)
+{
+    fputc('"', f);
+
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((u8)*s < 0x20)
+            fprintf(f, "\\u%04x", (u8)*s);
+        else
+            fputc(*s, f);
+    }
+
+    fputc('"', f);
+}
+
+bool TraceWriteJson(const char* path, i32* numEvents)
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+    FILE* f = fopen(path, "w");
+    bool rv = false;
+
+    *numEvents = 0;
+
+    if (f != nullptr)
+    {
+        bool first = true;
+
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+        for (auto& b : traceBuffers)
+        {
+            u64 count = b->count.load(std::memory_order_acquire);
+            u64 oldest = count > TRACE_RING_EVENTS ? count - TRACE_RING_EVENTS : 0;
+
+            for (u64 n = oldest; n < count; ++n)
+            {
+                const TraceEvent* e = &b->events[n & (TRACE_RING_EVENTS - 1)];
+
+                // zones that were open when tracing started
+                if (e->startMicros < traceStartMicros)
+                    continue;
+
+                fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+                WriteJsonString(f, e->name);
+                fprintf(f, ",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%d}",
+                        (unsigned long long)(e->startMicros - traceStartMicros),
+                        (unsigned long long)(e->endMicros - e->startMicros), b->threadIndex);
+
+                first = false;
+                ++*numEvents;
+            }
+        }
+
+        fprintf(f, "\n]}\n");
+        rv = ferror(f) == 0;
+        fclose(f);
+    }
+
+    return rv;
+}
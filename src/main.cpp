@@ -2,9 +2,11 @@
 
 #include <stdio.h>
 
-int main()
+// arguments are config overrides, like: DiscretionTwo video::headless=1 connection::username=Bob
+int main(int argc, char** argv)
 {
-    Client c;
+    vector<string> cfgOverrides(argv + 1, argv + argc);
+    Client c(cfgOverrides);
 
     c.Start();
 
@@ -0,0 +1,513 @@
+/*
+ * Microbenchmarks for the client's hot paths
+ *
+ * usage: DiscretionBench [-t msPerBenchmark] [-f filter] [-m mapfile.lvl] [-o results.json] [-w]
+ *                        [section::name=value ...]
+ *
+ *   -f  only run benchmarks whose name contains filter
+ *   -m  the .lvl used by the map benchmarks (one is generated if not given)
+ *   -o  also write the results as json, one object per benchmark, for tracking across releases
+ *   -w  open a window, so text benchmarks render surfaces (headless only measures wrapping)
+ *
+ * Benchmarks run against a real Client, created like the replay tool's (Net::StartReplay, so
+ * nothing is sent). Each one runs in batches for the given time after a warmup, and the median
+ * and fastest batch are reported. 'make bench' compiles everything with BENCH_OPT into its own
+ * object dir, independent of the client's CFLAGS. The flags are written into each json record,
+ * and an unoptimized build warns before running.
+ */
+
+#include "Client.h"
+#include "Chat.h"
+#include "Connection.h"
+#include "Graphics.h"
+#include "Map.h"
+#include "Net.h"
+#include "NetCoreHandlers.h"
+#include "Packets.h"
+#include "zlib.h"
+
+#include "GeneratedMap.h"
+
+#include <algorithm>
+#include <random>
+
+static const char* GENERATED_MAP_PATH = "bench_map.lvl";
+
+// set by the Makefile's bench rule
+#ifndef BENCH_BUILD_FLAGS
+#define BENCH_BUILD_FLAGS "unknown"
+#endif
+
+#ifdef __OPTIMIZE__
+static const bool BUILD_OPTIMIZED = true;
+#else
+static const bool BUILD_OPTIMIZED = false;
+#endif
+
+// outgoing templates the client uses (incoming ones are loaded when handlers are registered)
+static const char* OUTGOING_TEMPLATES[] = {
+    "arena login",    "cancel stream request", "change ship request",
+    "map request",    "outgoing chat",         "password request",
+    "sync ping",
+};
+
+struct BenchSettings
+{
+    i32 msPerBenchmark = 500;
+    string filter;
+    string mapPath;  // empty = generate one
+    string jsonPath;
+    bool window = false;
+    vector<string> cfgOverrides;
+};
+
+struct BenchResult
+{
+    string name;
+    u64 iterations;
+    i32 itemsPerOp;  // packets or bytes handled per iteration
+    const char* itemName;
+    double medianNs;  // per item
+    double minNs;
+};
+
+class Bench
+{
+   public:
+    Bench(const BenchSettings* s) : s(s) {}
+
+    bool Run();
+
+   private:
+    const BenchSettings* s;
+    shared_ptr<Client> client;
+    double counterToNs = 0;
+    vector<BenchResult> results;
+
+    void Measure(const string& name, i32 itemsPerOp, const char* itemName,
+                 std::function<void()> op);
+
+    void PacketBenchmarks();
+    void ReliableBenchmarks();
+    void FlushBenchmark();
+    void MapBenchmarks();
+    void TextBenchmarks();
+
+    void WriteJson();
+};
+
+// run op in batches for msPerBenchmark, per item times come from the batches
+void Bench::Measure(const string& name, i32 itemsPerOp, const char* itemName,
+                    std::function<void()> op)
+{
+    if (name.find(s->filter) == string::npos)
+        return;
+
+    const double MIN_BATCH_NS = 1000000;  // so timer resolution doesn't matter
+
+    // warm up, and find a batch size
+    u64 batch = 1;
+
+    for (;;)
+    {
+        u64 start = SDL_GetPerformanceCounter();
+
+        for (u64 i = 0; i < batch; ++i)
+            op();
+
+        if ((SDL_GetPerformanceCounter() - start) * counterToNs >= MIN_BATCH_NS)
+            break;
+
+        batch *= 2;
+    }
+
+    vector<double> batchNs;
+    u64 iterations = 0;
+    double totalNs = 0;
+
+    while (totalNs < s->msPerBenchmark * 1000000.0 || batchNs.size() < 5)
+    {
+        u64 start = SDL_GetPerformanceCounter();
+
+        for (u64 i = 0; i < batch; ++i)
+            op();
+
+        double ns = (SDL_GetPerformanceCounter() - start) * counterToNs;
+
+        batchNs.push_back(ns / (batch * itemsPerOp));
+        totalNs += ns;
+        iterations += batch;
+    }
+
+    sort(batchNs.begin(), batchNs.end());
+
+    BenchResult r = {name, iterations, itemsPerOp, itemName, batchNs[batchNs.size() / 2],
+                     batchNs[0]};
+    results.push_back(r);
+
+    printf("%-48s %12.1f ns/%s\n", name.c_str(), r.medianNs, itemName);
+    fflush(stdout);
+}
+
+// Packets::PopulatePacketInstance and PacketTemplateToRaw, for every loaded template
+void Bench::PacketBenchmarks()
+{
+    vector<string> incoming, outgoing;
+
+    for (const char* name : OUTGOING_TEMPLATES)
+        client->packets->GetPacketType(name, true);
+
+    client->packets->GetLoadedTemplateNames(&incoming, &outgoing);
+
+    for (const string& name : incoming)
+    {
+        // an instance with no values set encodes as all zeros, which decodes fine
+        PacketInstance pi(name.c_str());
+        vector<u8> raw;
+
+        client->packets->PacketTemplateToRaw(&pi, false, &raw);
+
+        Measure("packets/encode/" + name, 1, "packet", [&]()
+                {
+                    client->packets->PacketTemplateToRaw(&pi, false, &raw);
+                });
+
+        Measure("packets/decode/" + name, 1, "packet", [&]()
+                {
+                    PacketInstance store("temp");
+                    client->packets->PopulatePacketInstance(&store, raw.data(), raw.size());
+                });
+    }
+
+    for (const string& name : outgoing)
+    {
+        PacketInstance pi(name.c_str());
+        vector<u8> raw;
+
+        Measure("packets/encode/" + name, 1, "packet", [&]()
+                {
+                    client->packets->PacketTemplateToRaw(&pi, true, &raw);
+                });
+    }
+}
+
+// NetCoreHanders::handleReliablePacket, in order and with each group of packets reversed
+// (so everything but one gets backlogged)
+void Bench::ReliableBenchmarks()
+{
+    const i32 GROUP = 64;
+    const u8 KEEP_ALIVE = 0x27;  // in the ignore list, so handling it costs nothing
+
+    NetCoreHanders handlers(*client);
+    u32 nextId = 0;
+    vector<vector<u8>> group(GROUP, vector<u8>(7));
+
+    auto makeGroup = [&](bool reversed)
+    {
+        for (i32 i = 0; i < GROUP; ++i)
+        {
+            vector<u8>& p = group[reversed ? GROUP - 1 - i : i];
+
+            p[0] = CORE_HEADER;
+            p[1] = RELIABLE_HEADER;
+            PutU32(&p[2], nextId++);
+            p[6] = KEEP_ALIVE;
+        }
+    };
+
+    Measure("net/reliable/in_order", GROUP, "packet", [&]()
+            {
+                makeGroup(false);
+
+                for (vector<u8>& p : group)
+                    handlers.handleReliablePacket(p.data(), p.size());
+
+                client->net->SendPackets(0);  // the acks
+            });
+
+    handlers.Reset();
+    nextId = 0;
+
+    Measure("net/reliable/reversed", GROUP, "packet", [&]()
+            {
+                makeGroup(true);
+
+                for (vector<u8>& p : group)
+                    handlers.handleReliablePacket(p.data(), p.size());
+
+                client->net->SendPackets(0);
+            });
+}
+
+// clustering of queued packets in Net (FlushRawOutgoingPackets), with a mix of sizes
+void Bench::FlushBenchmark()
+{
+    const i32 NUM_PACKETS = 32;
+    mt19937 rng(1);
+    uniform_int_distribution<i32> chatLen(1, 300);
+    vector<PacketInstance> packets;
+
+    for (i32 i = 0; i < NUM_PACKETS; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            packets.push_back(PacketInstance("reliable response"));
+            packets.back().SetValue("id", i);
+        }
+        else
+        {
+            packets.push_back(PacketInstance("outgoing chat"));
+            packets.back().SetValue("type", 2);
+            packets.back().SetValue("sound", 0);
+            packets.back().SetValue("target", 0);
+            packets.back().SetValue("message", string(chatLen(rng), 'x').c_str());
+        }
+    }
+
+    Measure("net/flush_clustered", NUM_PACKETS, "packet", [&]()
+            {
+                for (PacketInstance& pi : packets)
+                    client->net->SendPacket(&pi);
+
+                client->net->SendPackets(0);
+            });
+}
+
+// write the tools' generated map to path
+static void WriteGeneratedMap(const char* path)
+{
+    vector<u8> lvl;
+    GenerateMap(&lvl);
+
+    FILE* f = fopen(path, "wb");
+
+    if (f)
+    {
+        fwrite(lvl.data(), 1, lvl.size(), f);
+        fclose(f);
+    }
+}
+
+// ZlibDecompress of the map download, and Map::SetMapPath
+void Bench::MapBenchmarks()
+{
+    string path = s->mapPath;
+
+    if (path.empty())
+    {
+        path = GENERATED_MAP_PATH;
+        WriteGeneratedMap(path.c_str());
+    }
+
+    FILE* f = fopen(path.c_str(), "rb");
+
+    if (!f)
+    {
+        fprintf(stderr, "Error opening map file '%s', skipping map benchmarks\n", path.c_str());
+        return;
+    }
+
+    vector<u8> lvl;
+    u8 buf[8192];
+    size_t got = 0;
+
+    while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+        lvl.insert(lvl.end(), buf, buf + got);
+
+    fclose(f);
+
+    uLongf compressedLen = compressBound(lvl.size());
+    vector<u8> compressed(compressedLen);
+    compress2(compressed.data(), &compressedLen, lvl.data(), lvl.size(), Z_BEST_COMPRESSION);
+
+    Measure("map/zlib_decompress", lvl.size(), "byte", [&]()
+            {
+                i32 len = 0;
+                ZlibDecompress(*client, compressed.data(), compressedLen, &len);
+            });
+
+    Measure("map/set_map_path", 1, "load", [&]()
+            {
+                client->map->SetMapPath(path.c_str());
+            });
+
+    client->map->SetMapPath(nullptr);
+}
+
+// wrapping (and with a window, rendering) of long chat lines
+void Bench::TextBenchmarks()
+{
+    const i32 WRAP_PIXELS = 400;
+    string ascii, utf8;
+
+    for (i32 i = 0; i < 40; ++i)
+    {
+        ascii += "the quick brown fox jumps over the lazy dog ";
+        utf8 += "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe6\x96\x87 ";
+    }
+
+    if (client->graphics->IsHeadless())
+    {
+        vector<TextSpan> spans;
+
+        Measure("text/wrap/ascii", 1, "message", [&]()
+                {
+                    spans.clear();
+                    client->graphics->WrapText(spans, ascii.c_str(), WRAP_PIXELS);
+                });
+
+        Measure("text/wrap/utf8", 1, "message", [&]()
+                {
+                    spans.clear();
+                    client->graphics->WrapText(spans, utf8.c_str(), WRAP_PIXELS);
+                });
+    }
+    else
+    {
+        vector<shared_ptr<DrawnText>> store;
+
+        Measure("text/render_wrapped/ascii", 1, "message", [&]()
+                {
+                    store.clear();
+                    client->graphics->MakeDrawnChat(store, Layer_Chat, Color_Green, WRAP_PIXELS,
+                                                    "player", ascii.c_str());
+                });
+
+        Measure("text/render_wrapped/utf8", 1, "message", [&]()
+                {
+                    store.clear();
+                    client->graphics->MakeDrawnChat(store, Layer_Chat, Color_Green, WRAP_PIXELS,
+                                                    "player", utf8.c_str());
+                });
+    }
+}
+
+void Bench::WriteJson()
+{
+    FILE* f = fopen(s->jsonPath.c_str(), "w");
+
+    if (!f)
+        fprintf(stderr, "Error opening '%s' for writing\n", s->jsonPath.c_str());
+    else
+    {
+        fprintf(f, "[\n");
+
+        for (u32 i = 0; i < results.size(); ++i)
+        {
+            const BenchResult& r = results[i];
+
+            fprintf(f,
+                    "  {\"name\": \"%s\", \"iterations\": %llu, \"items_per_iteration\": %d, "
+                    "\"item\": \"%s\", \"median_ns\": %.2f, \"min_ns\": %.2f, "
+                    "\"build_flags\": \"%s\", \"optimized\": %s}%s\n",
+                    r.name.c_str(), (unsigned long long)r.iterations, r.itemsPerOp, r.itemName,
+                    r.medianNs, r.minNs, BENCH_BUILD_FLAGS, BUILD_OPTIMIZED ? "true" : "false",
+                    i + 1 < results.size() ? "," : "");
+        }
+
+        fprintf(f, "]\n");
+        fclose(f);
+    }
+}
+
+bool Bench::Run()
+{
+    vector<string> overrides = {"log::print_level=error", "log::filename=bench_log.txt",
+                                "net::capture file="};
+
+    if (!s->window)
+        overrides.push_back("video::headless=1");
+
+    overrides.insert(overrides.end(), s->cfgOverrides.begin(), s->cfgOverrides.end());
+
+    client = make_shared<Client>(overrides);
+    counterToNs = 1000000000.0 / SDL_GetPerformanceFrequency();
+
+    // connected, with nowhere to send, so queued packets get flushed
+    client->net->StartReplay();
+    client->net->NewConnection("bench", 0);
+
+    PacketBenchmarks();
+    ReliableBenchmarks();
+    FlushBenchmark();
+    MapBenchmarks();
+    TextBenchmarks();
+
+    client->net->DisconnectSocket();
+
+    if (!s->jsonPath.empty())
+        WriteJson();
+
+    return !results.empty();
+}
+
+static void Usage()
+{
+    printf(
+        "usage: DiscretionBench [-t msPerBenchmark] [-f filter] [-m mapfile.lvl] "
+        "[-o results.json] [-w]\n"
+        "                       [section::name=value ...]\n");
+}
+
+int main(int argc, char** argv)
+{
+    BenchSettings s;
+
+    for (i32 i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if (arg.find("::") != string::npos)
+            s.cfgOverrides.push_back(arg);
+        else if (arg == "-w")
+            s.window = true;
+        else if (arg.length() == 2 && arg[0] == '-' && i + 1 < argc)
+        {
+            const char* val = argv[++i];
+
+            switch (arg[1])
+            {
+                case 't':
+                    s.msPerBenchmark = atoi(val);
+                    break;
+                case 'f':
+                    s.filter = val;
+                    break;
+                case 'm':
+                    s.mapPath = val;
+                    break;
+                case 'o':
+                    s.jsonPath = val;
+                    break;
+                default:
+                    Usage();
+                    return 1;
+            }
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (s.msPerBenchmark <= 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!BUILD_OPTIMIZED)
+        fprintf(stderr,
+                "\n*** WARNING: DiscretionBench was built without optimization, its numbers\n"
+                "*** don't reflect a release build. Build it with 'make bench'.\n\n");
+
+    bool success = false;
+
+    {
+        Bench bench(&s);
+        success = bench.Run();
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+// The generated map shared by the tools (zone server stand-in and benchmarks), used when no
+// .lvl is given. Header only, with no client dependencies, so the zone server links alone.
+
+#pragma once
+
+#include "Compatibility.h"
+
+#include <random>
+#include <vector>
+
+static const i32 GENERATED_MAP_TILES = 1024;
+
+// a .lvl file is a list of 4 byte tiles (12 bits x, 12 bits y, 8 bits tile type). Border walls
+// plus scattered tiles, seeded so every run produces the same map.
+inline void GenerateMap(std::vector<u8>* lvl)
+{
+    const i32 SCATTERED_TILES = 20000;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<i32> coord(1, GENERATED_MAP_TILES - 2);
+    std::uniform_int_distribution<i32> tileType(1, 160);
+
+    auto addTile = [lvl](i32 x, i32 y, i32 tile)
+    {
+        u8 t[4] = {(u8)(x & 0xFF), (u8)(((x >> 8) & 0x0F) | ((y & 0x0F) << 4)), (u8)(y >> 4),
+                   (u8)tile};
+
+        lvl->insert(lvl->end(), t, t + 4);
+    };
+
+    for (i32 i = 0; i < GENERATED_MAP_TILES; ++i)
+    {
+        addTile(i, 0, 1);
+        addTile(i, GENERATED_MAP_TILES - 1, 1);
+        addTile(0, i, 1);
+        addTile(GENERATED_MAP_TILES - 1, i, 1);
+    }
+
+    for (i32 i = 0; i < SCATTERED_TILES; ++i)
+        addTile(coord(rng), coord(rng), tileType(rng));
+}
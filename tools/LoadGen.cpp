@@ -0,0 +1,433 @@
+/*
+ * Load generator, runs many headless client sessions in one process against a single zone
+ *
+ * usage: DiscretionLoad [-n sessions] [-t seconds] [-r reportSeconds] [-s staggerMs]
+ *                       [-i inputChangeMs] [-p namePrefix] [section::name=value ...]
+ *
+ * Each session is a full Client (Connection, Net, Players, ...) in headless mode. All sessions
+ * share one loop: sockets are waited on together, and the simulation advances in fixed steps
+ * for every session at once. Config overrides given on the command line apply to all sessions
+ * (connection::connect_addr=127.0.0.1:5000 for example).
+ */
+
+#include "Client.h"
+#include "SDLman.h"
+#include "Graphics.h"
+#include "Net.h"
+#include "Connection.h"
+#include "Ships.h"
+
+#include <random>
+#include <cmath>
+
+#ifdef WIN32
+#include <direct.h>
+#define MKDIR(a) _mkdir(a)
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#define MKDIR(a) mkdir(a, S_IRWXU | S_IRGRP | S_IROTH)
+#endif
+
+static const char* LOG_DIR = "loadgen_logs";
+
+struct LoadGenSettings
+{
+    i32 numSessions = 10;
+    i32 durationSec = 0;  // 0 = until interrupted
+    i32 reportSec = 5;
+    i32 staggerMs = 100;  // delay between session connects
+    i32 inputChangeMs = 500;
+    string namePrefix = "loadbot";
+    vector<string> cfgOverrides;
+};
+
+struct LoadSession
+{
+    LoadSession(i32 index, const LoadGenSettings* s)
+        : name(s->namePrefix + to_string(index)), connectInMs(index * s->staggerMs), rng(index)
+    {
+        vector<string> overrides = {
+            "video::headless=1", "log::print_level=error",
+            "log::filename=" + string(LOG_DIR) + "/" + name + ".txt",
+            "connection::username=" + name,
+        };
+
+        overrides.insert(overrides.end(), s->cfgOverrides.begin(), s->cfgOverrides.end());
+
+        client = make_shared<Client>(overrides);
+    }
+
+    shared_ptr<Client> client;
+    string name;
+
+    i32 connectInMs;  // countdown until Connect() is called
+    bool started = false;
+    bool inGame = false;
+    bool dropped = false;  // gave up connecting, or got disconnected
+
+    i32 nextInputMs = 0;
+    mt19937 rng;
+
+    void Connect();
+    void ScriptInput(i32 inputChangeMs);
+    void Step(i32 ms, i32 inputChangeMs);
+};
+
+void LoadSession::Connect()
+{
+    string addr = client->cfg->Values().connectionConnectAddr;
+    string pw = client->cfg->Values().connectionPassword;
+    size_t index = addr.find(":");
+
+    if (index == string::npos)
+        client->log->FatalError("Malformed connection::connect_addr '%s'", addr.c_str());
+
+    string hostname = addr.substr(0, index);
+    i32 port = atoi(addr.substr(index + 1).c_str());
+    string zone = "custom_" + hostname;
+
+    client->connection->Connect(name.c_str(), pw.c_str(), zone.c_str(), hostname.c_str(),
+                                (u16)port);
+}
+
+// hold down a random set of movement keys for a random time
+void LoadSession::ScriptInput(i32 inputChangeMs)
+{
+    uniform_int_distribution<i32> percent(0, 99);
+    i32 turn = percent(rng);
+
+    client->ships->UpPressed(percent(rng) < 60);
+    client->ships->DownPressed(percent(rng) < 10);
+    client->ships->LeftPressed(turn < 30);
+    client->ships->RightPressed(turn >= 70);
+
+    nextInputMs = inputChangeMs / 2 + percent(rng) * inputChangeMs / 100;
+}
+
+void LoadSession::Step(i32 ms, i32 inputChangeMs)
+{
+    if (!started)
+    {
+        connectInMs -= ms;
+
+        if (connectInMs <= 0)
+        {
+            started = true;
+            Connect();
+        }
+    }
+    else if (!dropped)
+    {
+        if (client->connection->isCompletelyDisconnected())
+        {
+            dropped = true;
+            client->log->LogError("Session '%s' was disconnected", name.c_str());
+        }
+        else if (!inGame && client->connection->isCompletelyConnected())
+        {
+            inGame = true;
+
+            uniform_int_distribution<i32> ship(Ship_Warbird, Ship_Shark);
+            client->ships->RequestChangeShip((ShipType)ship(rng));
+        }
+        else if (inGame && (nextInputMs -= ms) <= 0)
+            ScriptInput(inputChangeMs);
+    }
+
+    client->sdl->AdvanceState(ms);
+}
+
+class LoadGen
+{
+   public:
+    LoadGen(const LoadGenSettings* s) : s(s) {}
+    ~LoadGen();
+
+    void Run();
+
+   private:
+    const LoadGenSettings* s;
+    vector<shared_ptr<LoadSession>> sessions;
+
+    SDLNet_SocketSet socketSet = nullptr;
+    vector<UDPsocket> setSockets;  // what's currently in socketSet
+
+    NetStats lastTotals;
+    double lastReportMs = 0;
+
+    void UpdateSocketSet();
+    void WaitForData(u32 timeoutMs);
+    void Report(double nowMs);
+    void FinalReport(double nowMs);
+};
+
+LoadGen::~LoadGen()
+{
+    // disconnect cleanly, so the server doesn't keep ghosts around
+    for (auto& session : sessions)
+        session->client->connection->Disconnect();
+
+    sessions.clear();
+
+    if (socketSet)
+        SDLNet_FreeSocketSet(socketSet);
+}
+
+// sockets change when sessions connect or disconnect
+void LoadGen::UpdateSocketSet()
+{
+    bool changed = false;
+
+    for (u32 i = 0; i < sessions.size(); ++i)
+    {
+        if (sessions[i]->client->net->GetSocket() != setSockets[i])
+            changed = true;
+    }
+
+    if (changed)
+    {
+        for (UDPsocket sock : setSockets)
+        {
+            if (sock)
+                SDLNet_UDP_DelSocket(socketSet, sock);
+        }
+
+        for (u32 i = 0; i < sessions.size(); ++i)
+        {
+            setSockets[i] = sessions[i]->client->net->GetSocket();
+
+            if (setSockets[i])
+                SDLNet_UDP_AddSocket(socketSet, setSockets[i]);
+        }
+    }
+}
+
+// sleep until a socket has data or timeoutMs passes, received data is processed right away
+void LoadGen::WaitForData(u32 timeoutMs)
+{
+    UpdateSocketSet();
+
+    bool anySockets = false;
+
+    for (UDPsocket sock : setSockets)
+        anySockets = anySockets || sock != nullptr;
+
+    if (!anySockets)
+        SDL_Delay(timeoutMs);
+    else if (SDLNet_CheckSockets(socketSet, timeoutMs) > 0)
+    {
+        for (u32 i = 0; i < sessions.size(); ++i)
+        {
+            if (setSockets[i] && SDLNet_SocketReady(setSockets[i]))
+                sessions[i]->client->net->ReceivePackets(0);
+        }
+    }
+}
+
+void LoadGen::Report(double nowMs)
+{
+    NetStats totals;
+    i32 inGame = 0, dropped = 0;
+
+    for (auto& session : sessions)
+    {
+        totals.Add(session->client->net->GetStats());
+
+        if (session->inGame && !session->dropped)
+            ++inGame;
+
+        if (session->dropped)
+            ++dropped;
+    }
+
+    double sec = (nowMs - lastReportMs) / 1000.0;
+    u64 reliableSent = totals.reliableSent - lastTotals.reliableSent;
+    u64 reliableResent = totals.reliableResent - lastTotals.reliableResent;
+
+    // rtt percentiles for just this interval
+    NetStats interval = totals;
+
+    for (i32 i = 0; i < NetStats::RTT_BUCKETS; ++i)
+        interval.rttHistogram[i] -= lastTotals.rttHistogram[i];
+
+    interval.rttSamples -= lastTotals.rttSamples;
+
+    printf(
+        "[%6.1fs] in game %d/%d (dropped %d) | out %.0f pkt/s %.1f KB/s | in %.0f pkt/s %.1f KB/s"
+        " | rtt p50 %d p90 %d p99 %d ms | retransmit %.2f%%\n",
+        nowMs / 1000.0, inGame, (i32)sessions.size(), dropped,
+        (totals.packetsSent - lastTotals.packetsSent) / sec,
+        (totals.bytesSent - lastTotals.bytesSent) / sec / 1024.0,
+        (totals.packetsReceived - lastTotals.packetsReceived) / sec,
+        (totals.bytesReceived - lastTotals.bytesReceived) / sec / 1024.0,
+        interval.RttPercentile(50), interval.RttPercentile(90), interval.RttPercentile(99),
+        reliableSent > 0 ? 100.0 * reliableResent / reliableSent : 0.0);
+    fflush(stdout);
+
+    lastTotals = totals;
+    lastReportMs = nowMs;
+}
+
+void LoadGen::FinalReport(double nowMs)
+{
+    double sec = nowMs / 1000.0;
+
+    printf("\n%-16s %-8s %10s %10s %10s %10s %8s %8s %8s\n", "session", "state", "out pkt/s",
+           "in pkt/s", "rel sent", "resent", "retx %", "rtt p50", "rtt p99");
+
+    for (auto& session : sessions)
+    {
+        const NetStats* st = session->client->net->GetStats();
+        const char* state = session->dropped ? "dropped" : session->inGame ? "in game"
+                                                                            : "joining";
+
+        printf("%-16s %-8s %10.1f %10.1f %10llu %10llu %8.2f %8d %8d\n", session->name.c_str(),
+               state, st->packetsSent / sec, st->packetsReceived / sec,
+               (unsigned long long)st->reliableSent, (unsigned long long)st->reliableResent,
+               st->reliableSent > 0 ? 100.0 * st->reliableResent / st->reliableSent : 0.0,
+               st->RttPercentile(50), st->RttPercentile(99));
+    }
+}
+
+void LoadGen::Run()
+{
+    MKDIR(LOG_DIR);
+
+    printf("Starting %d sessions (logs in %s/)\n", s->numSessions, LOG_DIR);
+
+    for (i32 i = 0; i < s->numSessions; ++i)
+        sessions.push_back(make_shared<LoadSession>(i, s));
+
+    socketSet = SDLNet_AllocSocketSet(s->numSessions);
+    setSockets.resize(sessions.size(), nullptr);
+
+    // same fixed step as the regular client
+    double msPerIteration = 1000.0 / sessions[0]->client->cfg->Values().gameTicksPerSecond;
+    double counterToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    // rendering only does bookkeeping (expiring animations) when headless, so it's done rarely
+    const double RENDER_INTERVAL_MS = 1000;
+    double lastRenderMs = 0;
+
+    u64 startCounter = SDL_GetPerformanceCounter();
+    double simulatedMs = 0;
+    bool quit = false;
+
+    while (!quit)
+    {
+        double nowMs = (SDL_GetPerformanceCounter() - startCounter) * counterToMs;
+
+        while (nowMs - simulatedMs >= msPerIteration)
+        {
+            i32 stepMs = (i32)(floor(simulatedMs + msPerIteration) - floor(simulatedMs));
+            simulatedMs += msPerIteration;
+
+            SDL_Event event;
+
+            while (SDL_PollEvent(&event))
+            {
+                if (event.type == SDL_QUIT)
+                    quit = true;
+            }
+
+            for (auto& session : sessions)
+                session->Step(stepMs, s->inputChangeMs);
+        }
+
+        if (nowMs - lastRenderMs >= RENDER_INTERVAL_MS)
+        {
+            for (auto& session : sessions)
+                session->client->graphics->Render((i32)(nowMs - lastRenderMs), 1.0f);
+
+            lastRenderMs = nowMs;
+        }
+
+        if (nowMs - lastReportMs >= s->reportSec * 1000.0)
+            Report(nowMs);
+
+        if (s->durationSec > 0 && nowMs >= s->durationSec * 1000.0)
+            quit = true;
+
+        if (!quit)
+        {
+            double untilNextStep = simulatedMs + msPerIteration - nowMs;
+
+            if (untilNextStep >= 1)
+                WaitForData((u32)untilNextStep);
+        }
+    }
+
+    FinalReport((SDL_GetPerformanceCounter() - startCounter) * counterToMs);
+}
+
+static void Usage()
+{
+    printf(
+        "usage: DiscretionLoad [-n sessions] [-t seconds] [-r reportSeconds] [-s staggerMs]\n"
+        "                      [-i inputChangeMs] [-p namePrefix] [section::name=value ...]\n");
+}
+
+int main(int argc, char** argv)
+{
+    LoadGenSettings s;
+
+    for (i32 i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if (arg.find("::") != string::npos)
+            s.cfgOverrides.push_back(arg);
+        else if (arg.length() == 2 && arg[0] == '-' && i + 1 < argc)
+        {
+            const char* val = argv[++i];
+
+            switch (arg[1])
+            {
+                case 'n':
+                    s.numSessions = atoi(val);
+                    break;
+                case 't':
+                    s.durationSec = atoi(val);
+                    break;
+                case 'r':
+                    s.reportSec = atoi(val);
+                    break;
+                case 's':
+                    s.staggerMs = atoi(val);
+                    break;
+                case 'i':
+                    s.inputChangeMs = atoi(val);
+                    break;
+                case 'p':
+                    s.namePrefix = val;
+                    break;
+                default:
+                    Usage();
+                    return 1;
+            }
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (s.numSessions <= 0 || s.reportSec <= 0 || s.inputChangeMs <= 0 || s.staggerMs < 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    SDLNet_Init();
+
+    {
+        LoadGen gen(&s);
+        gen.Run();
+    }
+
+    SDLNet_Quit();
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * Packet capture replay, feeds a capture (Net::Capture File) back through a client without a
+ * socket, for reproducible profiling of packet decoding, dispatch, player updates and rendering
+ *
+ * usage: DiscretionReplay [-f] [-w] capture.dcap [section::name=value ...]
+ *
+ *   -f  replay as fast as possible, rather than at the recorded speed
+ *   -w  open a window and draw, rather than running headless
+ *
+ * The client connects as usual (with Net::StartReplay, so nothing goes out) and the received
+ * packets are given to Net::PumpPacket at their recorded times, with the simulation advancing in
+ * the same fixed steps as the regular client. Sent packets in the capture are only counted; the
+ * user's input isn't replayed.
+ */
+
+#include "Client.h"
+#include "SDLman.h"
+#include "Graphics.h"
+#include "Net.h"
+#include "Connection.h"
+
+#include <cmath>
+
+struct ReplaySettings
+{
+    bool asFastAsPossible = false;
+    bool window = false;
+    string capturePath;
+    vector<string> cfgOverrides;
+};
+
+// where the time went, in ms
+struct ReplayTimes
+{
+    double pump = 0;     // decoding and handling received packets
+    double advance = 0;  // simulation steps
+    double render = 0;
+};
+
+class Replay
+{
+   public:
+    Replay(const ReplaySettings* s) : s(s) {}
+    ~Replay();
+
+    bool Run();
+
+   private:
+    const ReplaySettings* s;
+    shared_ptr<Client> client;
+    FILE* f = nullptr;
+
+    double counterToMs = 0;
+    ReplayTimes times;
+
+    u64 packetsPumped = 0;
+    u64 bytesPumped = 0;
+    u64 packetsSkipped = 0;  // sent by the recorded client
+    u64 steps = 0;
+
+    double ElapsedMs(u64 startCounter);
+    void Step(i32 ms);
+    void PrintReport(double wallMs, double simulatedMs);
+};
+
+Replay::~Replay()
+{
+    if (f)
+        fclose(f);
+}
+
+double Replay::ElapsedMs(u64 startCounter)
+{
+    return (SDL_GetPerformanceCounter() - startCounter) * counterToMs;
+}
+
+void Replay::Step(i32 ms)
+{
+    u64 start = SDL_GetPerformanceCounter();
+    client->sdl->AdvanceState(ms);
+    times.advance += ElapsedMs(start);
+
+    start = SDL_GetPerformanceCounter();
+    client->graphics->Render(ms, 1.0f);
+    times.render += ElapsedMs(start);
+
+    ++steps;
+}
+
+bool Replay::Run()
+{
+    bool rv = false;
+    vector<string> overrides = {"log::print_level=error", "log::filename=replay_log.txt",
+                                "net::capture file="};
+
+    if (!s->window)
+        overrides.push_back("video::headless=1");
+
+    overrides.insert(overrides.end(), s->cfgOverrides.begin(), s->cfgOverrides.end());
+
+    f = fopen(s->capturePath.c_str(), "rb");
+
+    if (!f)
+        fprintf(stderr, "Error opening capture file '%s'\n", s->capturePath.c_str());
+    else if (!ReadCaptureHeader(f))
+        fprintf(stderr, "'%s' is not a packet capture (or is from another version)\n",
+                s->capturePath.c_str());
+    else
+    {
+        client = make_shared<Client>(overrides);
+        counterToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+        double msPerIteration = 1000.0 / client->cfg->Values().gameTicksPerSecond;
+
+        client->net->StartReplay();
+        client->connection->Connect(client->connection->GetPlayerName(), "", "replay", "replay",
+                                    0);
+
+        CaptureRecord rec;
+        double firstRecordMs = -1;
+        double simulatedMs = 0;
+        u64 startCounter = SDL_GetPerformanceCounter();
+        bool quit = false;
+
+        while (!quit && ReadCaptureRecord(f, &rec))
+        {
+            if (firstRecordMs < 0)
+                firstRecordMs = rec.microseconds / 1000.0;
+
+            if (rec.direction != Capture_Received)
+            {
+                ++packetsSkipped;
+                continue;
+            }
+
+            double recordMs = rec.microseconds / 1000.0 - firstRecordMs;
+
+            // bring the simulation up to the packet's time
+            while (!quit && recordMs - simulatedMs >= msPerIteration)
+            {
+                i32 stepMs = (i32)(floor(simulatedMs + msPerIteration) - floor(simulatedMs));
+                simulatedMs += msPerIteration;
+
+                if (!s->asFastAsPossible)
+                {
+                    double aheadMs = simulatedMs - ElapsedMs(startCounter);
+
+                    if (aheadMs >= 1)
+                        SDL_Delay((u32)aheadMs);
+                }
+
+                SDL_Event event;
+
+                while (SDL_PollEvent(&event))
+                {
+                    if (event.type == SDL_QUIT)
+                        quit = true;
+                }
+
+                Step(stepMs);
+            }
+
+            u64 start = SDL_GetPerformanceCounter();
+            client->net->PumpPacket(rec.data.data(), rec.data.size());
+            times.pump += ElapsedMs(start);
+
+            ++packetsPumped;
+            bytesPumped += rec.data.size();
+        }
+
+        PrintReport(ElapsedMs(startCounter), simulatedMs);
+
+        client->connection->Disconnect();
+        rv = true;
+    }
+
+    return rv;
+}
+
+void Replay::PrintReport(double wallMs, double simulatedMs)
+{
+    u64 frames = 0, draws = 0;
+    client->graphics->GetDrawCounts(&frames, &draws);
+
+    printf("replayed %llu packets (%.1f KB), skipped %llu sent packets\n",
+           (unsigned long long)packetsPumped, bytesPumped / 1024.0,
+           (unsigned long long)packetsSkipped);
+    printf("%.1f s recorded in %.1f s (%.1fx), %llu steps, %llu frames, %llu draws\n",
+           simulatedMs / 1000.0, wallMs / 1000.0, wallMs > 0 ? simulatedMs / wallMs : 0.0,
+           (unsigned long long)steps, (unsigned long long)frames, (unsigned long long)draws);
+    printf("%-10s %10s %12s\n", "phase", "total ms", "us each");
+    printf("%-10s %10.1f %12.2f\n", "pump", times.pump,
+           packetsPumped > 0 ? 1000.0 * times.pump / packetsPumped : 0.0);
+    printf("%-10s %10.1f %12.2f\n", "advance", times.advance,
+           steps > 0 ? 1000.0 * times.advance / steps : 0.0);
+    printf("%-10s %10.1f %12.2f\n", "render", times.render,
+           steps > 0 ? 1000.0 * times.render / steps : 0.0);
+}
+
+static void Usage()
+{
+    printf("usage: DiscretionReplay [-f] [-w] capture.dcap [section::name=value ...]\n");
+}
+
+int main(int argc, char** argv)
+{
+    ReplaySettings s;
+
+    for (i32 i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if (arg.find("::") != string::npos)
+            s.cfgOverrides.push_back(arg);
+        else if (arg == "-f")
+            s.asFastAsPossible = true;
+        else if (arg == "-w")
+            s.window = true;
+        else if (arg[0] != '-' && s.capturePath.empty())
+            s.capturePath = arg;
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (s.capturePath.empty())
+    {
+        Usage();
+        return 1;
+    }
+
+    SDLNet_Init();
+
+    bool success = false;
+
+    {
+        Replay replay(&s);
+        success = replay.Run();
+    }
+
+    SDLNet_Quit();
+
+    return success ? 0 : 1;
+}
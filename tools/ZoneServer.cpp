@@ -0,0 +1,951 @@
+/*
+ * Local zone server stand-in, for testing the client's network path without an ASSS install
+ *
+ * usage: DiscretionZone [-p port] [-m mapfile.lvl] [-f framesPerSecond] [-b bots]
+ *                       [-w reliableWindow] [-r reportSeconds]
+ *
+ * Only the subset of the protocol the client uses is spoken: the encryption request handshake
+ * (no encryption), the reliable layer, password and arena login, pid change / player entering /
+ * player leaving, ship changes, chat, the map info packet and the compressed map stream, and
+ * discretion frames (0xD0, see dphysics_packets.h) at the given rate. Bots are fake players
+ * that fly in circles, they only exist in frames and player entering packets.
+ *
+ * Without -m, a map is generated (border walls plus scattered tiles), so the map download has
+ * something to send.
+ */
+
+#include "Compatibility.h"
+#include "dphysics_packets.h"
+#include "GeneratedMap.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_net.h>
+#include "zlib.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// the client only allocates this much for receiving
+static const i32 MAX_PACKET = 512;
+static const i32 MAX_STREAM_CHUNK = 480;
+
+static const i32 RELIABLE_RESEND_MS = 300;
+static const i32 RELIABLE_MAX_TRIES = 10;
+static const i32 TIMEOUT_MS = 10000;
+
+static const i32 MAP_TILES = 1024;
+static const i32 MAP_CENTER_PIXEL = MAP_TILES * 16 / 2;
+static const char* GENERATED_MAP_NAME = "standin.lvl";
+static const i32 BOT_PID_START = 1000;
+static const i32 SHIP_SPEC = 8;
+
+static void PutU32(u8* loc, u32 data)
+{
+    for (int x = 0; x < 4; ++x)
+    {
+        loc[x] = data % 256;
+        data /= 256;
+    }
+}
+
+static void PutU16(u8* loc, u16 data)
+{
+    loc[0] = data % 256;
+    loc[1] = data / 256;
+}
+
+static u32 GetU32(const u8* loc)
+{
+    return loc[0] | (loc[1] << 8) | (loc[2] << 16) | ((u32)loc[3] << 24);
+}
+
+// writes a fixed length, zero padded string
+static void PutString(u8* loc, const string& s, u32 len)
+{
+    memset(loc, 0, len);
+    memcpy(loc, s.c_str(), min((u32)s.length(), len));
+}
+
+struct ServerSettings
+{
+    u16 port = 5000;
+    string mapPath;  // empty = generate one
+    i32 framesPerSecond = 60;
+    i32 numBots = 8;
+    i32 reliableWindow = 64;  // max unacked reliable packets per peer
+    i32 reportSec = 5;
+};
+
+struct ServerStats
+{
+    u64 packetsSent = 0;
+    u64 packetsReceived = 0;
+    u64 bytesSent = 0;
+    u64 bytesReceived = 0;
+    u64 reliableSent = 0;
+    u64 reliableResent = 0;
+    u64 framesSent = 0;
+    u64 mapBytesQueued = 0;
+};
+
+struct Peer
+{
+    struct OutgoingReliable
+    {
+        u32 id;
+        vector<u8> data;  // including the reliable header
+        u32 lastSendMs;
+        i32 tries;
+    };
+
+    IPaddress addr;
+    u16 pid = 0;
+    string name;
+    u8 ship = SHIP_SPEC;
+    u16 freq = 0;
+    bool inArena = false;
+
+    u32 lastRecvMs = 0;
+
+    u32 nextInReliableId = 0;
+    map<u32, vector<u8>> backlog;  // reliable packets that arrived early
+
+    u32 nextOutReliableId = 0;
+    list<OutgoingReliable> inFlight;
+    deque<vector<u8>> waiting;  // reliable packets past the window, not yet numbered
+};
+
+class ZoneServer
+{
+   public:
+    ZoneServer(const ServerSettings* s) : s(s) {}
+    ~ZoneServer();
+
+    bool Start();
+    void Run();
+
+   private:
+    const ServerSettings* s;
+    ServerStats stats;
+    ServerStats lastStats;
+
+    UDPsocket sock = nullptr;
+    UDPpacket* packet = nullptr;
+    SDLNet_SocketSet socketSet = nullptr;
+
+    // keyed by (host, port)
+    map<pair<u32, u16>, shared_ptr<Peer>> peers;
+    u16 nextPid = 0;
+
+    // the map, as sent to clients
+    string mapName;
+    u32 mapCrc = 0;
+    vector<u8> compressedMapPacket;  // 0x2A packet: type, filename[16], zlib data
+
+    u32 frameNum = 0;
+
+    bool LoadMap();
+
+    void SendRaw(Peer* p, const u8* data, i32 len);
+    void SendReliable(Peer* p, const u8* data, i32 len);
+    void SendToArena(const u8* data, i32 len, bool reliable, Peer* except);
+    void PumpReliable(Peer* p, u32 nowMs);
+
+    void HandleConnect(const IPaddress* addr, const u8* data, i32 len, u32 nowMs);
+    void HandlePacket(Peer* p, const u8* data, i32 len);
+    void HandleCore(Peer* p, const u8* data, i32 len);
+    void HandleReliable(Peer* p, const u8* data, i32 len);
+    void HandleGame(Peer* p, const u8* data, i32 len);
+    void RemovePeer(Peer* p, const char* reason);
+
+    void MakePlayerEntering(u8* store, u16 pid, const string& name, u8 ship, u16 freq);
+    void SendArenaEntry(Peer* p);
+    void SendMap(Peer* p);
+    void SendFrame();
+
+    void Report(double elapsedSec);
+};
+
+ZoneServer::~ZoneServer()
+{
+    if (packet)
+        SDLNet_FreePacket(packet);
+
+    if (socketSet)
+        SDLNet_FreeSocketSet(socketSet);
+
+    if (sock)
+        SDLNet_UDP_Close(sock);
+}
+
+bool ZoneServer::Start()
+{
+    bool rv = false;
+
+    sock = SDLNet_UDP_Open(s->port);
+
+    if (!sock)
+        fprintf(stderr, "SDLNet_UDP_Open(%d): %s\n", s->port, SDLNet_GetError());
+    else
+    {
+        packet = SDLNet_AllocPacket(MAX_PACKET * 4);  // clients may send clusters up to 512
+        socketSet = SDLNet_AllocSocketSet(1);
+        SDLNet_UDP_AddSocket(socketSet, sock);
+
+        rv = LoadMap();
+    }
+
+    return rv;
+}
+
+bool ZoneServer::LoadMap()
+{
+    bool rv = true;
+    vector<u8> lvl;
+
+    if (s->mapPath.empty())
+    {
+        mapName = GENERATED_MAP_NAME;
+        GenerateMap(&lvl);
+    }
+    else
+    {
+        FILE* f = fopen(s->mapPath.c_str(), "rb");
+
+        if (!f)
+        {
+            fprintf(stderr, "Error opening map file '%s'\n", s->mapPath.c_str());
+            rv = false;
+        }
+        else
+        {
+            u8 buf[8192];
+            size_t got = 0;
+
+            while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+                lvl.insert(lvl.end(), buf, buf + got);
+
+            fclose(f);
+
+            size_t slash = s->mapPath.find_last_of("/\\");
+            mapName = slash == string::npos ? s->mapPath : s->mapPath.substr(slash + 1);
+            mapName = mapName.substr(0, 15);
+        }
+    }
+
+    if (rv)
+    {
+        mapCrc = crc32(crc32(0, Z_NULL, 0), lvl.data(), lvl.size());
+
+        uLongf compressedLen = compressBound(lvl.size());
+        compressedMapPacket.resize(1 + 16 + compressedLen);
+        compressedMapPacket[0] = 0x2A;
+        PutString(&compressedMapPacket[1], mapName, 16);
+
+        if (compress2(&compressedMapPacket[17], &compressedLen, lvl.data(), lvl.size(),
+                      Z_BEST_COMPRESSION) != Z_OK)
+        {
+            fprintf(stderr, "zlib compress failed\n");
+            rv = false;
+        }
+        else
+        {
+            compressedMapPacket.resize(1 + 16 + compressedLen);
+
+            printf("Map '%s': %d bytes, %d compressed, crc32 0x%08x\n", mapName.c_str(),
+                   (i32)lvl.size(), (i32)compressedLen, mapCrc);
+        }
+    }
+
+    return rv;
+}
+
+void ZoneServer::SendRaw(Peer* p, const u8* data, i32 len)
+{
+    if (len > MAX_PACKET)
+    {
+        fprintf(stderr, "Dropping outgoing packet 0x%02x of length %d\n", data[0], len);
+        return;
+    }
+
+    memcpy(packet->data, data, len);
+    packet->len = len;
+    packet->address = p->addr;
+
+    if (SDLNet_UDP_Send(sock, -1, packet))
+    {
+        ++stats.packetsSent;
+        stats.bytesSent += len;
+    }
+}
+
+void ZoneServer::SendReliable(Peer* p, const u8* data, i32 len)
+{
+    p->waiting.push_back(vector<u8>(data, data + len));
+    ++stats.reliableSent;
+
+    PumpReliable(p, SDL_GetTicks());
+}
+
+// number and send waiting packets while there's room in the window, resend old ones
+void ZoneServer::PumpReliable(Peer* p, u32 nowMs)
+{
+    for (auto& r : p->inFlight)
+    {
+        if (nowMs - r.lastSendMs >= (u32)RELIABLE_RESEND_MS)
+        {
+            r.lastSendMs = nowMs;
+            ++r.tries;
+            ++stats.reliableResent;
+
+            SendRaw(p, r.data.data(), r.data.size());
+        }
+    }
+
+    while (!p->waiting.empty() && (i32)p->inFlight.size() < s->reliableWindow)
+    {
+        Peer::OutgoingReliable r;
+
+        r.id = p->nextOutReliableId++;
+        r.data.resize(6);
+        r.data[0] = 0x00;
+        r.data[1] = 0x03;
+        PutU32(&r.data[2], r.id);
+        r.data.insert(r.data.end(), p->waiting.front().begin(), p->waiting.front().end());
+        r.lastSendMs = nowMs;
+        r.tries = 1;
+
+        p->waiting.pop_front();
+        SendRaw(p, r.data.data(), r.data.size());
+        p->inFlight.push_back(r);
+    }
+}
+
+void ZoneServer::SendToArena(const u8* data, i32 len, bool reliable, Peer* except)
+{
+    for (auto& it : peers)
+    {
+        Peer* p = it.second.get();
+
+        if (p != except && p->inArena)
+        {
+            if (reliable)
+                SendReliable(p, data, len);
+            else
+                SendRaw(p, data, len);
+        }
+    }
+}
+
+void ZoneServer::HandleConnect(const IPaddress* addr, const u8* data, i32 len, u32 nowMs)
+{
+    // 00 01 key(4) protocol(2), same check as enc_disc2
+    if (len != 8 || data[1] != 0x01 || data[6] != 0xD2 || data[7] != 0x00)
+        return;
+
+    pair<u32, u16> key(addr->host, addr->port);
+    shared_ptr<Peer> p = peers[key];
+
+    if (p == nullptr)
+    {
+        p = make_shared<Peer>();
+        p->addr = *addr;
+        p->pid = nextPid++;
+        peers[key] = p;
+    }
+
+    p->lastRecvMs = nowMs;
+
+    // echoing the key means no encryption
+    u8 response[6] = {0x00, 0x02};
+    memcpy(response + 2, data + 2, 4);
+
+    SendRaw(p.get(), response, sizeof(response));
+}
+
+void ZoneServer::HandlePacket(Peer* p, const u8* data, i32 len)
+{
+    if (len < 1)
+        return;
+
+    if (data[0] == 0x00)
+    {
+        if (len >= 2)
+            HandleCore(p, data, len);
+    }
+    else
+        HandleGame(p, data, len);
+}
+
+void ZoneServer::HandleCore(Peer* p, const u8* data, i32 len)
+{
+    switch (data[1])
+    {
+        case 0x03:  // reliable
+            if (len >= 6)
+                HandleReliable(p, data, len);
+            break;
+
+        case 0x04:  // reliable ack
+            if (len >= 6)
+            {
+                u32 id = GetU32(data + 2);
+
+                for (auto it = p->inFlight.begin(); it != p->inFlight.end(); ++it)
+                {
+                    if (it->id == id)
+                    {
+                        p->inFlight.erase(it);
+                        break;
+                    }
+                }
+
+                PumpReliable(p, SDL_GetTicks());
+            }
+            break;
+
+        case 0x05:  // sync ping
+            if (len >= 6)
+            {
+                u8 pong[10] = {0x00, 0x06};
+                memcpy(pong + 2, data + 2, 4);
+                PutU32(pong + 6, SDL_GetTicks() / 10);
+
+                SendRaw(p, pong, sizeof(pong));
+            }
+            break;
+
+        case 0x07:  // disconnect
+            RemovePeer(p, "disconnected");
+            break;
+
+        case 0x0B:  // cancel stream request
+        {
+            u8 response[2] = {0x00, 0x0C};
+            SendReliable(p, response, sizeof(response));
+            break;
+        }
+
+        case 0x0E:  // cluster
+        {
+            i32 offset = 2;
+
+            while (offset < len)
+            {
+                i32 segLen = data[offset++];
+
+                if (segLen > len - offset)
+                    break;
+
+                HandlePacket(p, data + offset, segLen);
+                offset += segLen;
+            }
+
+            break;
+        }
+    }
+}
+
+void ZoneServer::HandleReliable(Peer* p, const u8* data, i32 len)
+{
+    u32 id = GetU32(data + 2);
+
+    // ack everything at or before what we expect (old ones are duplicates, the ack was lost)
+    if (id <= p->nextInReliableId)
+    {
+        u8 ack[6] = {0x00, 0x04};
+        PutU32(ack + 2, id);
+        SendRaw(p, ack, sizeof(ack));
+    }
+    else if (p->backlog.find(id) == p->backlog.end())
+        p->backlog[id] = vector<u8>(data, data + len);
+
+    if (id == p->nextInReliableId)
+    {
+        ++p->nextInReliableId;
+        HandlePacket(p, data + 6, len - 6);
+
+        for (auto it = p->backlog.find(p->nextInReliableId); it != p->backlog.end();
+             it = p->backlog.find(p->nextInReliableId))
+        {
+            vector<u8> next = it->second;
+            p->backlog.erase(it);
+
+            u8 ack[6] = {0x00, 0x04};
+            PutU32(ack + 2, p->nextInReliableId);
+            SendRaw(p, ack, sizeof(ack));
+
+            ++p->nextInReliableId;
+            HandlePacket(p, next.data() + 6, next.size() - 6);
+        }
+    }
+}
+
+void ZoneServer::HandleGame(Peer* p, const u8* data, i32 len)
+{
+    switch (data[0])
+    {
+        case 0x09:  // password request: new user(1) name(32) password(32) ...
+            if (len >= 34)
+            {
+                p->name = string((const char*)data + 2, strnlen((const char*)data + 2, 20));
+
+                // password response, all zero = login ok
+                u8 response[36] = {0x0A};
+                SendReliable(p, response, sizeof(response));
+            }
+            break;
+
+        case 0x01:  // arena login
+            if (len >= 2 && !p->inArena)
+            {
+                p->ship = data[1] <= SHIP_SPEC ? data[1] : SHIP_SPEC;
+                SendArenaEntry(p);
+            }
+            break;
+
+        case 0x0C:  // map request
+            SendMap(p);
+            break;
+
+        case 0x18:  // change ship request
+            if (len >= 2 && p->inArena && data[1] <= SHIP_SPEC)
+            {
+                p->ship = data[1];
+
+                u8 changed[6] = {0x1D, p->ship};
+                PutU16(changed + 2, p->pid);
+                PutU16(changed + 4, p->freq);
+
+                SendToArena(changed, sizeof(changed), true, nullptr);
+            }
+            break;
+
+        case 0x06:  // outgoing chat: type(1) sound(1) target(2) message
+            if (len >= 6 && p->inArena)
+            {
+                // incoming chat: type(1) sound(1) pid(2) message
+                vector<u8> chat(data, data + len);
+                chat[0] = 0x07;
+                PutU16(&chat[3], p->pid);
+
+                if (chat.back() != 0)
+                    chat.push_back(0);
+
+                SendToArena(chat.data(), chat.size(), true, nullptr);
+            }
+            break;
+    }
+}
+
+void ZoneServer::MakePlayerEntering(u8* store, u16 pid, const string& name, u8 ship, u16 freq)
+{
+    // type(1) ship(1) unknown(1) name(20) squad(20) flag points(4) kill points(4) pid(2)
+    // freq(2) kills(2) deaths(2) turret pid(2) flags(2) koth(1) = 64 bytes
+    memset(store, 0, 64);
+    store[0] = 0x03;
+    store[1] = ship;
+    PutString(store + 3, name, 20);
+    PutU16(store + 51, pid);
+    PutU16(store + 53, freq);
+    PutU16(store + 59, 0xFFFF);  // no turret
+}
+
+void ZoneServer::SendArenaEntry(Peer* p)
+{
+    u8 buf[64];
+
+    // pid change
+    u8 pidChange[3] = {0x01};
+    PutU16(pidChange + 1, p->pid);
+    SendReliable(p, pidChange, sizeof(pidChange));
+
+    // everyone already here (including ourselves), and the bots
+    MakePlayerEntering(buf, p->pid, p->name, p->ship, p->freq);
+    SendReliable(p, buf, sizeof(buf));
+
+    for (auto& it : peers)
+    {
+        Peer* other = it.second.get();
+
+        if (other != p && other->inArena)
+        {
+            MakePlayerEntering(buf, other->pid, other->name, other->ship, other->freq);
+            SendReliable(p, buf, sizeof(buf));
+        }
+    }
+
+    for (i32 i = 0; i < s->numBots; ++i)
+    {
+        string name = "bot" + to_string(i);
+        MakePlayerEntering(buf, BOT_PID_START + i, name, i % 8, i % 2);
+        SendReliable(p, buf, sizeof(buf));
+    }
+
+    // map info: type, filename(16), checksum(4), compressed size(4)
+    u8 mapInfo[25] = {0x29};
+    PutString(mapInfo + 1, mapName, 16);
+    PutU32(mapInfo + 17, mapCrc);
+    PutU32(mapInfo + 21, compressedMapPacket.size());
+    SendReliable(p, mapInfo, sizeof(mapInfo));
+
+    // now in game
+    u8 inGame[1] = {0x02};
+    SendReliable(p, inGame, sizeof(inGame));
+
+    // tell everyone else
+    MakePlayerEntering(buf, p->pid, p->name, p->ship, p->freq);
+    SendToArena(buf, sizeof(buf), true, p);
+
+    p->inArena = true;
+    printf("'%s' entered the arena (pid %d)\n", p->name.c_str(), p->pid);
+}
+
+// the compressed map goes out as a stream: chunks of 00 0A totalLen(4) data, sent reliably
+void ZoneServer::SendMap(Peer* p)
+{
+    u32 total = compressedMapPacket.size();
+    u8 chunk[6 + MAX_STREAM_CHUNK] = {0x00, 0x0A};
+
+    PutU32(chunk + 2, total);
+
+    for (u32 offset = 0; offset < total; offset += MAX_STREAM_CHUNK)
+    {
+        u32 chunkLen = min(total - offset, (u32)MAX_STREAM_CHUNK);
+
+        memcpy(chunk + 6, &compressedMapPacket[offset], chunkLen);
+        SendReliable(p, chunk, 6 + chunkLen);
+    }
+
+    stats.mapBytesQueued += total;
+}
+
+void ZoneServer::RemovePeer(Peer* p, const char* reason)
+{
+    printf("'%s' left (pid %d): %s\n", p->name.c_str(), p->pid, reason);
+
+    if (p->inArena)
+    {
+        u8 leaving[3] = {0x04};
+        PutU16(leaving + 1, p->pid);
+        SendToArena(leaving, sizeof(leaving), true, p);
+    }
+
+    // the caller may still be using p, so the removal is only marked here
+    p->inArena = false;
+    p->lastRecvMs = 0;
+}
+
+// one snapshot of everyone, as dphysics sends it (fit to one packet, rotating if there are more)
+void ZoneServer::SendFrame()
+{
+    struct Entry
+    {
+        u16 pid;
+        string name;
+        u8 ship;
+        u16 freq;
+        u32 x, y;
+        u8 rot;
+    };
+
+    vector<Entry> entries;
+    double t = frameNum / (double)max(1, s->framesPerSecond);
+
+    for (auto& it : peers)
+    {
+        Peer* p = it.second.get();
+
+        if (p->inArena)
+            entries.push_back({p->pid, p->name, p->ship, p->freq, (u32)MAP_CENTER_PIXEL,
+                               (u32)MAP_CENTER_PIXEL, 0});
+    }
+
+    for (i32 i = 0; i < s->numBots; ++i)
+    {
+        double angle = t * 0.5 + i * 2 * M_PI / max(1, s->numBots);
+        i32 radius = 300 + 40 * (i % 8);
+        u32 x = MAP_CENTER_PIXEL + radius * cos(angle);
+        u32 y = MAP_CENTER_PIXEL + radius * sin(angle);
+        u8 rot = ((i32)(angle * 40 / (2 * M_PI)) + 10) % 40;
+
+        entries.push_back({(u16)(BOT_PID_START + i), "bot" + to_string(i), (u8)(i % 8),
+                           (u16)(i % 2), x, y, rot});
+    }
+
+    if (entries.empty())
+        return;
+
+    // player states for as many as fit, then pid states in the remaining space
+    i32 room = MAX_PACKET - sizeof(FrameHeader);
+    i32 numPlayers = min((i32)entries.size(), room / (i32)sizeof(PlayerState));
+    room -= numPlayers * sizeof(PlayerState);
+    i32 numPids = min((i32)entries.size(), room / (i32)sizeof(PidState));
+
+    u8 buf[MAX_PACKET];
+    FrameHeader* header = (FrameHeader*)buf;
+    u8* cur = buf + sizeof(FrameHeader);
+
+    header->packetType = S2C_DISC2_FRAME;
+    header->frameNum = frameNum;
+    header->numPidStates = numPids;
+    header->numPlayerStates = numPlayers;
+    header->numWeaponStates = 0;
+
+    for (i32 i = 0; i < numPids; ++i)
+    {
+        const Entry& e = entries[(frameNum * numPids + i) % entries.size()];
+        PidState ps;
+
+        memset(&ps, 0, sizeof(ps));
+        ps.pid = e.pid;
+        strncpy(ps.name, e.name.c_str(), sizeof(ps.name) - 1);
+        ps.ship = e.ship;
+        ps.freq = e.freq;
+
+        memcpy(cur, &ps, sizeof(ps));
+        cur += sizeof(ps);
+    }
+
+    for (i32 i = 0; i < numPlayers; ++i)
+    {
+        const Entry& e = entries[(frameNum * numPlayers + i) % entries.size()];
+        PlayerState ps;
+
+        memset(&ps, 0, sizeof(ps));
+        ps.pid = e.pid;
+        ps.rot = e.rot;
+        ps.xpixel = e.x;
+        ps.ypixel = e.y;
+
+        memcpy(cur, &ps, sizeof(ps));
+        cur += sizeof(ps);
+    }
+
+    for (auto& it : peers)
+    {
+        if (it.second->inArena)
+        {
+            SendRaw(it.second.get(), buf, cur - buf);
+            ++stats.framesSent;
+        }
+    }
+
+    ++frameNum;
+}
+
+void ZoneServer::Report(double elapsedSec)
+{
+    i32 inArena = 0;
+    u64 backlog = 0;
+
+    for (auto& it : peers)
+    {
+        if (it.second->inArena)
+            ++inArena;
+
+        backlog += it.second->waiting.size() + it.second->inFlight.size();
+    }
+
+    printf(
+        "%d players | out %.0f pkt/s %.1f KB/s | in %.0f pkt/s %.1f KB/s | reliable %.0f/s "
+        "resent %.0f/s unacked %llu | frames %.0f/s | map %.1f KB queued\n",
+        inArena, (stats.packetsSent - lastStats.packetsSent) / elapsedSec,
+        (stats.bytesSent - lastStats.bytesSent) / elapsedSec / 1024.0,
+        (stats.packetsReceived - lastStats.packetsReceived) / elapsedSec,
+        (stats.bytesReceived - lastStats.bytesReceived) / elapsedSec / 1024.0,
+        (stats.reliableSent - lastStats.reliableSent) / elapsedSec,
+        (stats.reliableResent - lastStats.reliableResent) / elapsedSec,
+        (unsigned long long)backlog, (stats.framesSent - lastStats.framesSent) / elapsedSec,
+        (stats.mapBytesQueued - lastStats.mapBytesQueued) / 1024.0);
+    fflush(stdout);
+
+    lastStats = stats;
+}
+
+void ZoneServer::Run()
+{
+    printf("Listening on port %d, %d bots, %d frames per second\n", s->port, s->numBots,
+           s->framesPerSecond);
+
+    u32 frameIntervalMs = s->framesPerSecond > 0 ? 1000 / s->framesPerSecond : 0;
+    u32 startMs = SDL_GetTicks();
+    u32 nextFrameMs = startMs;
+    u32 lastReportMs = startMs;
+    bool quit = false;
+
+    while (!quit)
+    {
+        u32 nowMs = SDL_GetTicks();
+        u32 waitMs = 10;
+
+        if (frameIntervalMs > 0)
+            waitMs = nextFrameMs > nowMs ? min(nextFrameMs - nowMs, (u32)10) : 0;
+
+        if (SDLNet_CheckSockets(socketSet, waitMs) > 0)
+        {
+            while (SDLNet_UDP_Recv(sock, packet) > 0)
+            {
+                const u8* data = packet->data;
+                i32 len = packet->len;
+                pair<u32, u16> key(packet->address.host, packet->address.port);
+                auto it = peers.find(key);
+
+                ++stats.packetsReceived;
+                stats.bytesReceived += len;
+                nowMs = SDL_GetTicks();
+
+                if (len >= 2 && data[0] == 0x00 && data[1] == 0x01)
+                    HandleConnect(&packet->address, data, len, nowMs);
+                else if (it != peers.end() && it->second->lastRecvMs != 0)
+                {
+                    // copy, since handlers reuse the packet for sending
+                    vector<u8> copy(data, data + len);
+
+                    it->second->lastRecvMs = nowMs;
+                    HandlePacket(it->second.get(), copy.data(), copy.size());
+                }
+            }
+        }
+
+        nowMs = SDL_GetTicks();
+
+        if (frameIntervalMs > 0 && nowMs >= nextFrameMs)
+        {
+            SendFrame();
+
+            nextFrameMs += frameIntervalMs;
+
+            // don't try to catch up after a stall
+            if (nextFrameMs < nowMs)
+                nextFrameMs = nowMs + frameIntervalMs;
+        }
+
+        // resends, timeouts, and removal of peers that left
+        for (auto it = peers.begin(); it != peers.end();)
+        {
+            Peer* p = it->second.get();
+
+            if (p->lastRecvMs != 0 && nowMs - p->lastRecvMs > (u32)TIMEOUT_MS)
+                RemovePeer(p, "timed out");
+
+            for (auto& r : p->inFlight)
+            {
+                if (p->lastRecvMs != 0 && r.tries >= RELIABLE_MAX_TRIES)
+                {
+                    RemovePeer(p, "too many reliable retries");
+                    break;
+                }
+            }
+
+            if (p->lastRecvMs == 0)
+                it = peers.erase(it);
+            else
+            {
+                PumpReliable(p, nowMs);
+                ++it;
+            }
+        }
+
+        if (nowMs - lastReportMs >= (u32)s->reportSec * 1000)
+        {
+            Report((nowMs - lastReportMs) / 1000.0);
+            lastReportMs = nowMs;
+        }
+
+        SDL_Event event;
+
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_QUIT)
+                quit = true;
+        }
+    }
+}
+
+static void Usage()
+{
+    printf(
+        "usage: DiscretionZone [-p port] [-m mapfile.lvl] [-f framesPerSecond] [-b bots]\n"
+        "                      [-w reliableWindow] [-r reportSeconds]\n");
+}
+
+int main(int argc, char** argv)
+{
+    ServerSettings s;
+
+    for (i32 i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if (arg.length() != 2 || arg[0] != '-' || i + 1 >= argc)
+        {
+            Usage();
+            return 1;
+        }
+
+        const char* val = argv[++i];
+
+        switch (arg[1])
+        {
+            case 'p':
+                s.port = atoi(val);
+                break;
+            case 'm':
+                s.mapPath = val;
+                break;
+            case 'f':
+                s.framesPerSecond = atoi(val);
+                break;
+            case 'b':
+                s.numBots = atoi(val);
+                break;
+            case 'w':
+                s.reliableWindow = atoi(val);
+                break;
+            case 'r':
+                s.reportSec = atoi(val);
+                break;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (s.framesPerSecond < 0 || s.numBots < 0 || s.reliableWindow <= 0 || s.reportSec <= 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    // events only, so ctrl-c arrives as SDL_QUIT
+    if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) == -1 || SDLNet_Init() == -1)
+    {
+        fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    i32 rv = 0;
+
+    {
+        ZoneServer server(&s);
+
+        if (server.Start())
+            server.Run();
+        else
+            rv = 1;
+    }
+
+    SDLNet_Quit();
+    SDL_Quit();
+
+    return rv;
+}